@@ -0,0 +1,213 @@
+#include <assert.h>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <random>
+
+// jobsystem settings
+#define JOBSYSTEM_ASSERT(...) assert(__VA_ARGS__) // Directs internal system asserts to app-specific assert mechanism.
+
+// jobsystem include
+#include "jobsystem.h"
+
+// Compares help-first and work-first spawning on recursive divide-and-conquer workloads (fib,
+// quicksort) and a flat fan-out (a parallel-for sum), then round-robin and push-to-idle submission
+// on bursts of jobs. For each, reports wall time and the peak number of queued jobs seen at the
+// leaves, which is what queue and job state memory grows with.
+
+namespace
+{
+    std::atomic<size_t> g_peakQueuedJobs(0); // Most queued jobs seen at a leaf.
+
+    void SampleQueuedJobs(const jobsystem::JobManager &jobManager)
+    {
+        const size_t queued = jobManager.GetQueuedJobCount();
+
+        size_t peak = g_peakQueuedJobs.load(std::memory_order_relaxed);
+        while (queued > peak && !g_peakQueuedJobs.compare_exchange_weak(peak, queued, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t SerialFib(uint64_t n)
+    {
+        return n < 2 ? n : SerialFib(n - 1) + SerialFib(n - 2);
+    }
+
+    uint64_t Fib(jobsystem::JobManager &jobManager, uint64_t n, jobsystem::ESpawnPolicy policy)
+    {
+        const uint64_t kSerialCutoff = 12;
+
+        if (n < kSerialCutoff)
+        {
+            SampleQueuedJobs(jobManager);
+            return SerialFib(n);
+        }
+
+        uint64_t a = 0, b = 0;
+
+        jobManager.ForkJoin(
+            [&]()
+            { a = Fib(jobManager, n - 1, policy); },
+            [&]()
+            { b = Fib(jobManager, n - 2, policy); },
+            policy);
+
+        return a + b;
+    }
+
+    void QuickSort(jobsystem::JobManager &jobManager, int *begin, int *end, jobsystem::ESpawnPolicy policy)
+    {
+        const ptrdiff_t kSerialCutoff = 2048;
+
+        if (end - begin <= kSerialCutoff)
+        {
+            SampleQueuedJobs(jobManager);
+            std::sort(begin, end);
+            return;
+        }
+
+        const int pivot = begin[(end - begin) / 2];
+        int *middle1 = std::partition(begin, end, [pivot](int value)
+                                      { return value < pivot; });
+        int *middle2 = std::partition(middle1, end, [pivot](int value)
+                                      { return !(pivot < value); });
+
+        jobManager.ForkJoin(
+            [&]()
+            { QuickSort(jobManager, begin, middle1, policy); },
+            [&]()
+            { QuickSort(jobManager, middle2, end, policy); },
+            policy);
+    }
+
+    template <typename Function>
+    void Run(const char *name, jobsystem::ESpawnPolicy policy, Function function)
+    {
+        g_peakQueuedJobs.store(0);
+
+        const auto start = std::chrono::steady_clock::now();
+        function(policy);
+        const auto end = std::chrono::steady_clock::now();
+
+        printf("%-10s %-11s %10.2f ms %10zu peak queued jobs\n", name, policy == jobsystem::eSpawnPolicy_WorkFirst ? "work-first" : "help-first",
+               std::chrono::duration<double, std::milli>(end - start).count(), g_peakQueuedJobs.load());
+    }
+}
+
+int main()
+{
+    jobsystem::JobManagerDescriptor jobManagerDesc;
+
+    const size_t kWorkerCount = std::max<size_t>(2, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < kWorkerCount; ++i)
+    {
+        jobManagerDesc.m_workers.emplace_back("Worker");
+    }
+
+    jobsystem::JobManager jobManager;
+    if (!jobManager.Create(jobManagerDesc))
+    {
+        return 1;
+    }
+
+    const uint64_t kFibN = 32;
+    const size_t kSortCount = 4 * 1024 * 1024;
+    const size_t kSumCount = 16 * 1024 * 1024;
+    const size_t kSumGrainSize = 1024;
+    const int kIterations = 3;
+
+    std::vector<int> input(kSortCount);
+    std::mt19937 random(1234);
+    for (int &value : input)
+    {
+        value = static_cast<int>(random());
+    }
+
+    std::vector<int> values(kSortCount);
+    std::vector<uint32_t> summands(kSumCount, 1);
+    const uint64_t kFibResult = SerialFib(kFibN);
+    (void)kFibResult;
+
+    const jobsystem::ESpawnPolicy policies[] = {jobsystem::eSpawnPolicy_HelpFirst, jobsystem::eSpawnPolicy_WorkFirst};
+
+    for (int iteration = 0; iteration < kIterations; ++iteration)
+    {
+        for (jobsystem::ESpawnPolicy policy : policies)
+        {
+            // Only the parallel work itself is timed; inputs are reset and results checked outside.
+            uint64_t fibResult = 0;
+            Run("fib", policy, [&](jobsystem::ESpawnPolicy p)
+                { fibResult = Fib(jobManager, kFibN, p); });
+            assert(fibResult == kFibResult);
+            (void)fibResult;
+
+            values = input;
+            Run("quicksort", policy, [&](jobsystem::ESpawnPolicy p)
+                { QuickSort(jobManager, values.data(), values.data() + values.size(), p); });
+            assert(std::is_sorted(values.begin(), values.end()));
+
+            std::atomic<uint64_t> sum(0);
+            Run("sum", policy, [&](jobsystem::ESpawnPolicy p)
+                { jobManager.ParallelFor(0, kSumCount, kSumGrainSize, [&](size_t begin, size_t end)
+                                         {
+                                             SampleQueuedJobs(jobManager);
+                                             uint64_t partialSum = 0;
+                                             for (size_t i = begin; i < end; ++i)
+                                                 partialSum += summands[i];
+                                             sum += partialSum; },
+                                         p); });
+            assert(sum == kSumCount);
+        }
+    }
+
+    // Submission policies, on bursts of independent jobs readied from outside the pool, as a frame
+    // loop would. Handing each job to a parked worker spares it stealing the job from another queue.
+    const size_t kBurstCount = 2000;
+    const size_t kBurstJobWork = 20000;
+
+    const jobsystem::ESubmissionPolicy submissionPolicies[] = {jobsystem::eSubmissionPolicy_RoundRobin, jobsystem::eSubmissionPolicy_PushToIdle};
+
+    for (jobsystem::ESubmissionPolicy submissionPolicy : submissionPolicies)
+    {
+        jobsystem::JobManagerDescriptor burstDesc = jobManagerDesc;
+        burstDesc.m_submissionPolicy = submissionPolicy;
+
+        jobsystem::JobManager burstManager;
+        if (!burstManager.Create(burstDesc))
+        {
+            return 1;
+        }
+
+        g_peakQueuedJobs.store(0);
+        std::vector<jobsystem::JobStatePtr> burst(kWorkerCount);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < kBurstCount; ++i)
+        {
+            for (jobsystem::JobStatePtr &job : burst)
+            {
+                job = burstManager.AddJob([&]()
+                                          {
+                                              SampleQueuedJobs(burstManager);
+                                              volatile size_t work = 0;
+                                              for (size_t j = 0; j < kBurstJobWork; ++j)
+                                                  work = work + j; });
+                job->SetReady();
+            }
+
+            for (jobsystem::JobStatePtr &job : burst)
+            {
+                burstManager.AssistUntilJobDone(job);
+            }
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+
+        printf("%-10s %-11s %10.2f ms %10zu peak queued jobs\n", "burst", submissionPolicy == jobsystem::eSubmissionPolicy_PushToIdle ? "push-idle" : "round-robin",
+               std::chrono::duration<double, std::milli>(end - start).count(), g_peakQueuedJobs.load());
+    }
+
+    return 0;
+}
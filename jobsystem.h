@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <vector>
 #include <deque>
+#include <queue>
 #include <array>
 #include <thread>
 #include <functional>
@@ -10,9 +11,31 @@
 #include <mutex>
 #include <condition_variable>
 #include <memory>
+#include <chrono>
+#include <string>
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <exception>
+
+#if defined(__linux__) && !defined(JOBSYSTEM_DISABLE_IO_URING)
+#define JOBSYSTEM_IO_URING_SUPPORTED
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif // __linux__ && !JOBSYSTEM_DISABLE_IO_URING
+
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+#define JOBSYSTEM_EXCEPTIONS_ENABLED
+#endif // __cpp_exceptions || __EXCEPTIONS
 
 namespace jobsystem
 {
@@ -39,739 +62,4761 @@ namespace jobsystem
     static const affinity_t kAffinityAllBits = static_cast<affinity_t>(~0);
 
     /**
-     * Global system components.
+     * epoll-based reactor, so file descriptor readiness can trigger jobs.
+     * - Each registration has a delegate, which is enqueued as a job when its fd becomes ready
+     * - Registrations are one-shot while their job is in flight, and re-armed once it completes
+     * - An eventfd lets job wakeups interrupt the wait, so a parked worker can sleep in epoll_wait()
+     *   and be woken for either I/O or new jobs through one mechanism
      */
-    std::atomic<size_t> s_nextJobId;         // Job ID assignment for debugging / profiling.
-    std::mutex s_signalLock;                 // Global mutex for worker signaling.
-    std::condition_variable s_signalThreads; // Global condition var for worker signaling.
-    std::atomic<size_t> s_activeWorkers;
-
-    inline affinity_t CalculateSafeWorkerAffinity(size_t workerIndex, size_t workerCount)
-    {
-        affinity_t affinity = kAffinityAllBits; // Set all bits so jobs with affinities out of range can still be processed.
-        affinity &= ~(workerCount - 1);         // Wipe bits within valid range.
-        affinity |= GetBit(workerIndex);        // Set worker-specific bit.
-
-        return affinity;
-    }
-
-    /**
-     * Offers access to the state of job.
-     * In particular, callers can use the Wait() function to ensure a given job is complete,
-     * or Cancel().
-     * Note, however, that doing so is not good practice with job systems. If no hardware threads
-     * are available to process a given job, you can stall the caller for significant time.
-     *
-     * Internally, the state manages dependencies as well as atomics describing the status of the job.
-     */
-    typedef std::shared_ptr<class JobState> JobStatePtr;
-
-    class JobState
+    class JobReactor
     {
-    private:
-        friend class JobSystemWorker;
-        friend class JobManager;
-
-        std::atomic<bool> m_cancel; // Is the job pending cancellation?
-        std::atomic<bool> m_ready;  // Has the job been marked as ready for processing?
-
-        std::vector<JobStatePtr> m_dependants; // List of dependent jobs.
-        std::atomic<int> m_dependencies;       // Number of outstanding dependencies.
-
-        std::atomic<bool> m_done; // Has the job executed to completion?
-        std::condition_variable m_doneSignal;
-        std::mutex m_doneMutex;
-
-        affinity_t m_workerAffinity; // Option to limit execution to specific worker threads / cores.
-
-        size_t m_jobId;   // Debug/profiling ID.
-        char m_debugChar; // Debug character for profiling display.
-
-        void SetQueued()
+    public:
+        JobReactor()
+            : m_epollFd(-1), m_wakeFd(-1), m_wakePending(false), m_nextRegistrationId(1)
         {
-            m_done.store(false, std::memory_order_release);
         }
 
-        void SetDone()
+        ~JobReactor()
         {
-            JOBSYSTEM_ASSERT(!IsDone());
-
-            for (const JobStatePtr &dependant : m_dependants)
+            if (m_wakeFd >= 0)
             {
-                dependant->m_dependencies.fetch_sub(1, std::memory_order_relaxed);
+                close(m_wakeFd);
             }
 
-            std::lock_guard<std::mutex> lock(m_doneMutex);
-            m_done.store(true, std::memory_order_release);
-            m_doneSignal.notify_all();
+            if (m_epollFd >= 0)
+            {
+                close(m_epollFd);
+            }
         }
 
-        bool AwaitingCancellation() const
+        bool Create()
         {
-            return m_cancel.load(std::memory_order_relaxed);
-        }
+            m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+            m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
-    public:
-        JobState()
-            : m_debugChar(0)
-        {
-            m_jobId = s_nextJobId++;
-            m_workerAffinity = kAffinityAllBits;
+            if (m_epollFd < 0 || m_wakeFd < 0)
+            {
+                return false;
+            }
 
-            m_dependencies.store(0, std::memory_order_release);
-            m_cancel.store(false, std::memory_order_release);
-            m_ready.store(false, std::memory_order_release);
-            m_done.store(false, std::memory_order_release);
-        }
+            // Registration ID 0 is reserved for the wake eventfd.
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.u64 = 0;
 
-        ~JobState() {}
+            return epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event) == 0;
+        }
 
-        JobState &SetReady()
+        uint64_t Register(int fd, uint32_t events, JobDelegate delegate)
         {
-            JOBSYSTEM_ASSERT(!IsDone());
-
-            m_cancel.store(false, std::memory_order_relaxed);
-            m_ready.store(true, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(m_registrationLock);
 
-            s_signalThreads.notify_all();
+            const uint64_t registrationId = m_nextRegistrationId++;
 
-            return *this;
-        }
+            struct epoll_event event;
+            event.events = events | EPOLLONESHOT;
+            event.data.u64 = registrationId;
 
-        JobState &Cancel()
-        {
-            JOBSYSTEM_ASSERT(!IsDone());
+            if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+            {
+                return 0;
+            }
 
-            m_cancel.store(true, std::memory_order_relaxed);
+            Registration &registration = m_registrations[registrationId];
+            registration.fd = fd;
+            registration.events = events;
+            registration.delegate = delegate;
 
-            return *this;
+            return registrationId;
         }
 
-        JobState &AddDependant(JobStatePtr dependant)
+        bool Unregister(uint64_t registrationId)
         {
-            JOBSYSTEM_ASSERT(m_dependants.end() == std::find(m_dependants.begin(), m_dependants.end(), dependant));
+            std::lock_guard<std::mutex> lock(m_registrationLock);
 
-            m_dependants.push_back(dependant);
+            auto registrationIter = m_registrations.find(registrationId);
+            if (registrationIter == m_registrations.end())
+            {
+                return false;
+            }
 
-            dependant->m_dependencies.fetch_add(1, std::memory_order_relaxed);
+            epoll_ctl(m_epollFd, EPOLL_CTL_DEL, registrationIter->second.fd, nullptr);
+            m_registrations.erase(registrationIter);
 
-            return *this;
+            return true;
         }
 
-        JobState &SetWorkerAffinity(affinity_t affinity)
+        void Wake()
         {
-            m_workerAffinity = affinity ? affinity : kAffinityAllBits;
-
-            return *this;
+            // Coalesce wakes: only one eventfd write is outstanding until a waiter consumes it.
+            if (!m_wakePending.exchange(true, std::memory_order_acq_rel))
+            {
+                const uint64_t value = 1;
+                ssize_t result = write(m_wakeFd, &value, sizeof(value));
+                (void)result;
+            }
         }
 
-        bool IsDone() const
+        void Wait(std::chrono::microseconds timeout, std::vector<JobDelegate> &readyDelegates)
         {
-            return m_done.load(std::memory_order_acquire);
-        }
+            // Waits for I/O readiness or a Wake(), and returns delegates for ready registrations,
+            // each wrapped to re-arm its registration once run. A zero timeout waits indefinitely.
+            const int timeoutMs = (timeout.count() == 0) ? -1 : static_cast<int>((timeout.count() + 999) / 1000);
 
-        bool Wait(size_t maxWaitMicroseconds = 0)
-        {
-            if (!IsDone())
+            static const int kMaxEvents = 64;
+            struct epoll_event events[kMaxEvents];
+
+            const int eventCount = epoll_wait(m_epollFd, events, kMaxEvents, timeoutMs);
+
+            for (int i = 0; i < eventCount; ++i)
             {
-                std::unique_lock<std::mutex> lock(m_doneMutex);
+                const uint64_t registrationId = events[i].data.u64;
 
-                if (maxWaitMicroseconds == 0)
+                if (registrationId == 0)
                 {
-                    m_doneSignal.wait(lock,
-                                      [this]()
-                                      {
-                                          return IsDone();
-                                      });
+                    // Clear the pending flag before draining, so a racing Wake() always leaves data behind.
+                    m_wakePending.store(false, std::memory_order_release);
+
+                    uint64_t value;
+                    ssize_t result = read(m_wakeFd, &value, sizeof(value));
+                    (void)result;
+
+                    continue;
                 }
-                else
+
+                std::lock_guard<std::mutex> lock(m_registrationLock);
+
+                auto registrationIter = m_registrations.find(registrationId);
+                if (registrationIter != m_registrations.end())
                 {
-                    m_doneSignal.wait_for(lock, std::chrono::microseconds(maxWaitMicroseconds));
+                    const JobDelegate delegate = registrationIter->second.delegate;
+
+                    readyDelegates.push_back(
+                        [this, registrationId, delegate]()
+                        {
+#ifdef JOBSYSTEM_EXCEPTIONS_ENABLED
+
+                            // The job boundary captures the exception, so re-arm first or the fd goes quiet for good.
+                            try
+                            {
+                                delegate();
+                            }
+                            catch (...)
+                            {
+                                Rearm(registrationId);
+                                throw;
+                            }
+
+#else
+
+                            delegate();
+
+#endif // JOBSYSTEM_EXCEPTIONS_ENABLED
+
+                            Rearm(registrationId);
+                        });
                 }
             }
-
-            return IsDone();
         }
 
-        bool AreDependenciesMet() const
+    private:
+        struct Registration
         {
-            if (!m_ready.load(std::memory_order_acquire))
-            {
-                return false;
-            }
+            int fd;               // Registered file descriptor.
+            uint32_t events;      // epoll events of interest.
+            JobDelegate delegate; // Delegate to enqueue as a job on readiness.
+        };
 
-            if (m_dependencies.load(std::memory_order_relaxed) > 0)
+        void Rearm(uint64_t registrationId)
+        {
+            std::lock_guard<std::mutex> lock(m_registrationLock);
+
+            auto registrationIter = m_registrations.find(registrationId);
+            if (registrationIter != m_registrations.end())
             {
-                return false;
-            }
+                struct epoll_event event;
+                event.events = registrationIter->second.events | EPOLLONESHOT;
+                event.data.u64 = registrationId;
 
-            return true;
+                epoll_ctl(m_epollFd, EPOLL_CTL_MOD, registrationIter->second.fd, &event);
+            }
         }
 
-        bool HasDependencies() const
-        {
-            return (m_dependencies.load(std::memory_order_relaxed) > 0);
-        }
-    };
+        int m_epollFd;                   // epoll instance.
+        int m_wakeFd;                    // eventfd used to interrupt epoll_wait() for job wakeups.
+        std::atomic<bool> m_wakePending; // Has the eventfd been written since the last drain?
 
-    /**
-     * Represents an entry in a job queue.
-     * - A delegate to invoke
-     * - Internal job state
-     */
-    struct JobQueueEntry
-    {
-        JobDelegate m_delegate; // Delegate to invoke for the job.
-        JobStatePtr m_state;    // Pointer to job state.
+        std::mutex m_registrationLock;                              // Guards m_registrations.
+        std::unordered_map<uint64_t, Registration> m_registrations; // Active registrations by ID.
+        uint64_t m_nextRegistrationId;                              // Next registration ID to assign.
     };
 
     /**
-     * Descriptor for a given job worker thread, to be provided by the host application.
+     * Hierarchical timer wheel for delayed and periodic jobs.
+     * - kLevelCount levels of kSlotsPerLevel slots; each level covers kSlotsPerLevel times the span of the one below
+     * - Timers live in intrusive doubly-linked slot lists, so scheduling and cancellation are O(1)
+     * - Timers are cascaded to lower levels as time advances, and expire from level 0
+     * There is no timer thread: idle workers advance the wheel, using their park timeout to wake for
+     * the next expiry, and busy workers advance it between jobs.
      */
-    struct JobWorkerDescriptor
+    class TimerWheel
     {
-        JobWorkerDescriptor(const char *name = "JobSystemWorker", affinity_t cpuAffinity = affinity_t(~0), bool enableWorkSteeling = true)
-            : m_name(name), m_cpuAffinity(cpuAffinity), m_enableWorkStealing(enableWorkSteeling)
+    public:
+        struct Timer
         {
-        }
-
-        std::string m_name;            // Worker name, for debug/profiling displays.
-        affinity_t m_cpuAffinity;      // Thread affinity. Defaults to all cores.
-        bool m_enableWorkStealing : 1; // Enable queue-sharing between workers?
-    };
-
-    /**
-     * Job events (for tracking/debugging).
-     */
-    enum EJobEvent
-    {
-        eJobEvent_JobPopped,      // A job was popped from a queue.
-        eJobEvent_JobStart,       // A job is about to start.
-        eJobEvent_JobDone,        // A job just completed.
-        eJobEvent_JobRun,         // A job has been completed.
-        eJobEvent_JobRunAssisted, // A job has been completed through outside assistance.
-        eJobEvent_JobStolen,      // A worker has stolen a job from another worker.
-        eJobEvent_WorkerAwoken,   // A worker has been awoken.
-        eJobEvent_WorkerUsed,     // A worker has been utilized.
-    };
+            Timer()
+                : prev(nullptr), next(nullptr), slotHead(nullptr), expiryTick(0), periodTicks(0), debugChar(0), scheduled(false)
+            {
+            }
 
-    typedef std::function<void(const JobQueueEntry &job, EJobEvent, uint64_t, size_t)> JobEventObserver; // Delegate definition for job event observation.
+            Timer *prev;          // Previous timer in the slot list.
+            Timer *next;          // Next timer in the slot list.
+            Timer **slotHead;     // Head of the slot list the timer is linked into.
+            uint64_t expiryTick;  // Tick at which the timer expires.
+            uint64_t periodTicks; // Re-scheduling period for periodic timers. Zero for one-shot timers.
 
-    typedef std::deque<JobQueueEntry> JobQueue; // Data structure to represent job queue.
+            JobDelegate delegate; // Delegate to enqueue as a job on expiry.
+            char debugChar;       // Debug character for the enqueued job.
 
-    /**
-     * High-res clock based on windows performance counter. Supports STL chrono interfaces.
-     */
-    using TimePoint = std::chrono::high_resolution_clock::time_point;
-    TimePoint ProfileClockNow()
-    {
-        return std::chrono::high_resolution_clock::now();
-    }
+            bool scheduled;              // Is the timer linked into the wheel? Guarded by the wheel's lock.
+            std::shared_ptr<Timer> self; // Keeps the timer alive while scheduled, independently of handles.
+        };
 
-    /**
-     * Tracking each job's start/end times in a per-worker timeline, for debugging/profiling.
-     */
-    class ProfilingTimeline
-    {
-    public:
-        struct TimelineEntry
+        struct ExpiredTimer
         {
-            uint64_t jobId;  // ID of the job that generated this timeline entry.
-            TimePoint start; // Job start time.
-            TimePoint end;   // Job end time.
-            char debugChar;  // Job's debug character for profiling display.
-
-            std::string description; // Timeline entry description.
+            JobDelegate delegate; // Delegate to enqueue as a job.
+            char debugChar;       // Debug character for the enqueued job.
         };
 
-        typedef std::vector<TimelineEntry> TimelineEntries;
-
-        TimelineEntries m_entries; //< List of timeline entries for this thread.
-    };
-
-    /**
-     * Represents a worker thread.
-     * - Owns a job queue
-     * - Implements work-stealing from other workers
-     */
-    class JobSystemWorker
-    {
-        friend class JobManager;
+        static const size_t kLevelBits = 6;
+        static const size_t kSlotsPerLevel = static_cast<size_t>(1) << kLevelBits;
+        static const size_t kLevelCount = 4;
 
-    public:
-        JobSystemWorker(const JobWorkerDescriptor &desc, const JobEventObserver &eventObserver)
-            : m_allWorkers(nullptr), m_workerCount(0), m_workerIndex(0), m_desc(desc), m_eventObserver(eventObserver), m_hasShutDown(false)
+        TimerWheel()
+            : m_resolution(1000), m_currentTick(0), m_pendingCount(0)
         {
+            memset(m_slots, 0, sizeof(m_slots));
         }
 
-        void Start(size_t index, JobSystemWorker **allWorkers, size_t workerCount)
+        void Reset(std::chrono::microseconds resolution)
         {
-            m_allWorkers = allWorkers;
-            m_workerCount = workerCount;
-            m_workerIndex = index;
+            std::lock_guard<std::mutex> lock(m_lock);
 
-            m_thread = std::thread(&JobSystemWorker::WorkerThreadProc, this);
+            for (size_t level = 0; level < kLevelCount; ++level)
+            {
+                for (size_t slot = 0; slot < kSlotsPerLevel; ++slot)
+                {
+                    while (Timer *timer = m_slots[level][slot])
+                    {
+                        // Handles may outlive the wheel's reference, but the delegate will never run.
+                        Unlink(timer);
+                        timer->delegate = nullptr;
+                        timer->self.reset();
+                    }
+                }
+            }
+
+            m_resolution = std::max<std::chrono::microseconds>(resolution, std::chrono::microseconds(1));
+            m_startTime = std::chrono::steady_clock::now();
+            m_currentTick.store(0, std::memory_order_relaxed);
+            m_pendingCount.store(0, std::memory_order_relaxed);
         }
 
-        void Shutdown()
+        std::shared_ptr<Timer> Schedule(size_t delayMicroseconds, size_t periodMicroseconds, JobDelegate delegate, char debugChar)
         {
-            m_stop.store(true, std::memory_order_relaxed);
+            std::shared_ptr<Timer> timer = std::make_shared<Timer>();
+            timer->delegate = delegate;
+            timer->debugChar = debugChar;
+            timer->periodTicks = periodMicroseconds ? std::max<uint64_t>(1, TicksFromMicroseconds(periodMicroseconds)) : 0;
 
-            while (!m_hasShutDown.load(std::memory_order_acquire))
-            {
-                s_signalThreads.notify_all();
+            std::lock_guard<std::mutex> lock(m_lock);
 
-                std::this_thread::sleep_for(std::chrono::microseconds(100));
-            }
+            // Round up so the timer never fires early, and never schedule into the current tick, which
+            // may already have been processed.
+            const uint64_t elapsedMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+            const uint64_t currentTick = m_currentTick.load(std::memory_order_relaxed);
+            timer->expiryTick = std::max<uint64_t>(TicksFromMicroseconds(elapsedMicroseconds + delayMicroseconds), currentTick + 1);
+            timer->self = timer;
 
-            if (m_hasShutDown.load(std::memory_order_acquire))
-            {
-                m_thread.join();
-            }
+            Link(timer.get());
+            m_pendingCount.fetch_add(1, std::memory_order_release);
+
+            return timer;
         }
 
-        JobStatePtr PushJob(JobDelegate delegate)
+        bool Cancel(const std::shared_ptr<Timer> &timer)
         {
-            JobQueueEntry entry = {delegate, std::make_shared<JobState>()};
-            entry.m_state->SetQueued();
+            std::lock_guard<std::mutex> lock(m_lock);
 
+            if (!timer || !timer->scheduled)
             {
-                std::lock_guard<std::mutex> queueLock(m_queueLock);
-                m_queue.insert(m_queue.begin(), entry);
+                return false;
             }
 
-            return entry.m_state;
+            Unlink(timer.get());
+            timer->self.reset();
+            m_pendingCount.fetch_sub(1, std::memory_order_release);
+
+            return true;
         }
 
-    private:
-        void NotifyEventObserver(const JobQueueEntry &job, EJobEvent event, uint64_t workerIndex, size_t jobId = 0)
+        bool HasPending() const
         {
-#ifdef JOBSYSTEM_ENABLE_PROFILING
+            return m_pendingCount.load(std::memory_order_acquire) > 0;
+        }
 
-            if (m_eventObserver)
+        bool IsDue() const
+        {
+            return HasPending() && NowTick() > m_currentTick.load(std::memory_order_acquire);
+        }
+
+        bool TimeUntilNextExpiry(std::chrono::microseconds &timeout)
+        {
+            // Returns false if no timers are pending. Otherwise returns the time until the next level-0
+            // expiry, or until the next cascade if level 0 is empty for the rest of its rotation.
+            if (!HasPending())
             {
-                m_eventObserver(job, event, workerIndex, jobId);
+                return false;
             }
 
-#endif // JOBSYSTEM_ENABLE_PROFILING
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            const uint64_t currentTick = m_currentTick.load(std::memory_order_relaxed);
+            uint64_t wakeTick = (currentTick | (kSlotsPerLevel - 1)) + 1;
+
+            for (uint64_t tick = currentTick + 1; tick < wakeTick; ++tick)
+            {
+                if (m_slots[0][tick & (kSlotsPerLevel - 1)])
+                {
+                    wakeTick = tick;
+                    break;
+                }
+            }
+
+            const auto wakeTime = m_startTime + m_resolution * wakeTick;
+            const auto now = std::chrono::steady_clock::now();
+
+            timeout = (wakeTime > now) ? std::chrono::duration_cast<std::chrono::microseconds>(wakeTime - now) + std::chrono::microseconds(1)
+                                       : std::chrono::microseconds(0);
+
+            return true;
         }
 
-        bool PopJobFromQueue(JobQueue &queue, JobQueueEntry &job, bool &hasUnsatisfiedDependencies, affinity_t workerAffinity)
+        bool Advance(std::vector<ExpiredTimer> &expired)
         {
-            for (auto jobIter = queue.begin(); jobIter != queue.end();)
+            // Processes every tick up to now, appending expired timers. Only one thread advances at a
+            // time; others return false immediately rather than wait.
+            std::unique_lock<std::mutex> lock(m_lock, std::try_to_lock);
+            if (!lock.owns_lock())
             {
-                const JobQueueEntry &candidate = (*jobIter);
+                return false;
+            }
+
+            const uint64_t targetTick = NowTick();
+            uint64_t tick = m_currentTick.load(std::memory_order_relaxed);
+
+            if (m_pendingCount.load(std::memory_order_relaxed) == 0)
+            {
+                m_currentTick.store(std::max(tick, targetTick), std::memory_order_release);
+                return true;
+            }
+
+            while (tick < targetTick)
+            {
+                ++tick;
+                m_currentTick.store(tick, std::memory_order_release);
 
-                if ((workerAffinity & candidate.m_state->m_workerAffinity) != 0)
+                // Cascade from the highest level whose rotation just wrapped, down to level 1.
+                for (size_t level = kLevelCount - 1; level > 0; --level)
                 {
-                    if (candidate.m_state->AwaitingCancellation())
+                    const uint64_t levelMask = (static_cast<uint64_t>(1) << (kLevelBits * level)) - 1;
+                    if ((tick & levelMask) != 0)
                     {
-                        candidate.m_state->SetDone();
-                        jobIter = queue.erase(jobIter);
-
                         continue;
                     }
-                    else if (candidate.m_state->AreDependenciesMet())
+
+                    Timer *timer = m_slots[level][(tick >> (kLevelBits * level)) & (kSlotsPerLevel - 1)];
+                    while (timer)
                     {
-                        job = candidate;
-                        queue.erase(jobIter);
+                        Timer *next = timer->next;
+                        Unlink(timer);
+                        Link(timer);
+                        timer = next;
+                    }
+                }
 
-                        NotifyEventObserver(job, eJobEvent_JobPopped, m_workerIndex);
+                while (Timer *timer = m_slots[0][tick & (kSlotsPerLevel - 1)])
+                {
+                    Unlink(timer);
 
-                        return true;
+                    ExpiredTimer entry = {timer->delegate, timer->debugChar};
+                    expired.push_back(entry);
+
+                    if (timer->periodTicks)
+                    {
+                        timer->expiryTick = tick + timer->periodTicks;
+                        Link(timer);
+                    }
+                    else
+                    {
+                        m_pendingCount.fetch_sub(1, std::memory_order_release);
+                        timer->self.reset(); // May destroy the timer.
                     }
                 }
+            }
 
-                hasUnsatisfiedDependencies = true;
-                ++jobIter;
+            return true;
+        }
+
+    private:
+        uint64_t TicksFromMicroseconds(uint64_t microseconds) const
+        {
+            return (microseconds + m_resolution.count() - 1) / m_resolution.count();
+        }
+
+        uint64_t NowTick() const
+        {
+            return static_cast<uint64_t>((std::chrono::steady_clock::now() - m_startTime) / m_resolution);
+        }
+
+        void Link(Timer *timer)
+        {
+            // Must be called with m_lock held. A timer goes in the lowest level whose current rotation
+            // contains its expiry. Expiries beyond the top level's range park in the top level's last
+            // slot before wrapping, and are re-linked when that slot cascades.
+            const uint64_t currentTick = m_currentTick.load(std::memory_order_relaxed);
+            const uint64_t expiryTick = std::max(timer->expiryTick, currentTick);
+
+            size_t level = 0;
+            while (level < kLevelCount - 1 && (expiryTick >> (kLevelBits * (level + 1))) != (currentTick >> (kLevelBits * (level + 1))))
+            {
+                ++level;
+            }
+
+            uint64_t slotTick = expiryTick >> (kLevelBits * level);
+            if (level == kLevelCount - 1)
+            {
+                slotTick = std::min<uint64_t>(slotTick, (currentTick >> (kLevelBits * level)) + kSlotsPerLevel - 1);
+            }
+
+            const size_t slot = static_cast<size_t>(slotTick & (kSlotsPerLevel - 1));
+
+            Timer *&head = m_slots[level][slot];
+            timer->prev = nullptr;
+            timer->next = head;
+            if (head)
+            {
+                head->prev = timer;
+            }
+            head = timer;
+
+            timer->slotHead = &head;
+            timer->scheduled = true;
+        }
+
+        void Unlink(Timer *timer)
+        {
+            // Must be called with m_lock held.
+            if (timer->prev)
+            {
+                timer->prev->next = timer->next;
+            }
+            else
+            {
+                *timer->slotHead = timer->next;
+            }
+
+            if (timer->next)
+            {
+                timer->next->prev = timer->prev;
+            }
+
+            timer->prev = timer->next = nullptr;
+            timer->slotHead = nullptr;
+            timer->scheduled = false;
+        }
+
+        std::mutex m_lock;                                 // Guards the wheel.
+        Timer *m_slots[kLevelCount][kSlotsPerLevel];       // Heads of each slot's timer list.
+        std::chrono::microseconds m_resolution;            // Duration of one tick.
+        std::chrono::steady_clock::time_point m_startTime; // Time of tick zero.
+        std::atomic<uint64_t> m_currentTick;               // Last tick processed.
+        std::atomic<size_t> m_pendingCount;                // Number of scheduled timers.
+    };
+
+    typedef std::shared_ptr<TimerWheel::Timer> TimerHandle; // Handle to a delayed or periodic job, for cancellation.
+
+    /**
+     * State shared between a job manager, its workers and its jobs.
+     * Each JobManager owns one, so separate managers never signal each other's workers.
+     */
+    struct JobSystemContext
+    {
+        JobSystemContext()
+            : m_nextJobId(0), m_busyWorkerCount(0), m_reactor(nullptr), m_hasParkedLeader(false), m_parkedFollowerCount(0), m_idleWorkerMask(0), m_parkedAssistCount(0), m_assistEpoch(0), m_queuedJobCount(0), m_activeWorkerCount(0), m_computeWorkerCount(0), m_blockedWorkerCount(0), m_activeSpareCount(0), m_minActiveWorkers(1), m_spawnQueueDepthPerWorker(1), m_idleRetirePeriod(0), m_spawnQueueLatency(0), m_cancelDependantsOnException(false), m_queueHighWatermark(0), m_aboveHighWatermark(false), m_blockedProducerCount(0), m_dequeueEpoch(0), m_deterministic(false), m_pushToIdle(false)
+        {
+        }
+
+        std::atomic<size_t> m_nextJobId;         // Job ID assignment for debugging / profiling.
+        std::mutex m_signalLock;                 // Mutex for worker signaling.
+        std::condition_variable m_signalThreads; // Condition var for worker signaling.
+        std::atomic<size_t> m_busyWorkerCount;   // Number of workers currently executing a job.
+
+        std::condition_variable m_leaderSignal;    // Condition var the leading parked worker waits on, when there's no reactor.
+        JobReactor *m_reactor;                     // Optional reactor. When present, the leading parked worker waits in it.
+        bool m_hasParkedLeader;                    // Is a parked worker currently leading? Guarded by m_signalLock.
+        std::atomic<size_t> m_parkedFollowerCount; // Number of parked workers following on m_signalThreads.
+        TimerWheel m_timers;                       // Delayed and periodic jobs, serviced by the leading parked worker.
+        std::atomic<affinity_t> m_idleWorkerMask;  // Bits of parked workers that haven't been handed a job since parking (see eSubmissionPolicy_PushToIdle).
+
+        std::mutex m_assistLock;                 // Mutex for assistant signaling. Separate from m_signalLock, which wakes may be issued under.
+        std::condition_variable m_assistSignal;  // Condition var that idle assisting threads (see JobManager::AssistUntilJobDone()) park on.
+        std::atomic<size_t> m_parkedAssistCount; // Number of assisting threads parked on m_assistSignal.
+        std::atomic<uint64_t> m_assistEpoch;     // Bumped by every WakeAssistants(), so assistants can tell whether they missed a wake before parking.
+
+        std::atomic<size_t> m_queuedJobCount;    // Number of jobs residing in worker queues.
+        std::atomic<size_t> m_activeWorkerCount; // Number of workers whose threads are spawned and not retired.
+
+        size_t m_computeWorkerCount;              // Number of regular workers. Any workers beyond this are spares.
+        std::atomic<size_t> m_blockedWorkerCount; // Number of workers currently inside a BlockingScope.
+        std::atomic<size_t> m_activeSpareCount;   // Number of spare workers spawned to stand in for blocked workers.
+
+        size_t m_minActiveWorkers;                     // Workers never retire below this count.
+        size_t m_spawnQueueDepthPerWorker;             // Queued jobs per active worker above which another worker is spawned.
+        std::chrono::microseconds m_idleRetirePeriod;  // Idle time after which a worker retires. Zero disables retirement.
+        std::chrono::microseconds m_spawnQueueLatency; // Queue wait time above which another worker is spawned. Zero disables monitoring.
+
+        bool m_cancelDependantsOnException; // Should a job that throws cancel its dependants?
+
+        size_t m_queueHighWatermark;                // Queued job count at which producers are notified. Zero disables.
+        std::atomic<bool> m_aboveHighWatermark;     // Has the watermark been crossed, without the queues draining to half of it since?
+        std::mutex m_queueSpaceLock;                // Mutex for producers blocked on full queues.
+        std::condition_variable m_queueSpaceSignal; // Condition var for producers blocked on full queues.
+        std::atomic<size_t> m_blockedProducerCount; // Number of producers waiting for queue space.
+        std::atomic<size_t> m_dequeueEpoch;         // Bumped on dequeue while producers are blocked, as their wakeup predicate.
+
+        bool m_deterministic; // Are jobs run one at a time by assisting threads, with no worker threads (see JobManagerDescriptor::m_deterministic)?
+        bool m_pushToIdle;    // Are jobs handed to idle workers as they become runnable (see eSubmissionPolicy_PushToIdle)?
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+        std::mutex m_validationLock;                     // Guards m_liveJobs, and the validation fields of each job.
+        std::unordered_set<class JobState *> m_liveJobs; // Every job state that exists, for the watchdog and orphan checks.
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+
+        bool OnJobQueued()
+        {
+            // Returns true if this job took the queues across the high watermark.
+            const size_t queuedCount = m_queuedJobCount.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+            return m_queueHighWatermark > 0 && queuedCount >= m_queueHighWatermark &&
+                   !m_aboveHighWatermark.load(std::memory_order_relaxed) && !m_aboveHighWatermark.exchange(true, std::memory_order_acq_rel);
+        }
+
+        void OnJobDequeued()
+        {
+            const size_t queuedCount = m_queuedJobCount.fetch_sub(1, std::memory_order_seq_cst) - 1;
+
+            // Re-arm with some hysteresis, so a queue hovering around the watermark doesn't flood producers.
+            if (queuedCount <= m_queueHighWatermark / 2 && m_aboveHighWatermark.load(std::memory_order_relaxed))
+            {
+                m_aboveHighWatermark.store(false, std::memory_order_relaxed);
+            }
+
+            // Producers register before re-checking for space, so either they see this dequeue or we see them.
+            if (m_blockedProducerCount.load(std::memory_order_seq_cst) > 0)
+            {
+                std::lock_guard<std::mutex> lock(m_queueSpaceLock);
+                m_dequeueEpoch.fetch_add(1, std::memory_order_relaxed);
+                m_queueSpaceSignal.notify_all();
+            }
+        }
+
+        bool TryClaimIdleWorker(size_t &workerIndex)
+        {
+            // Clears the lowest idle worker's bit, so each parked worker is handed at most one job
+            // before it wakes, and a burst fans out across all of them.
+            affinity_t idleMask = m_idleWorkerMask.load(std::memory_order_acquire);
+
+            while (idleMask != 0)
+            {
+                const size_t index = static_cast<size_t>(__builtin_ctzll(idleMask));
+
+                if (m_idleWorkerMask.compare_exchange_weak(idleMask, idleMask & ~GetBit(index), std::memory_order_acq_rel))
+                {
+                    workerIndex = index;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void WakeLeader()
+        {
+            if (m_reactor)
+            {
+                m_reactor->Wake();
+            }
+            else
+            {
+                m_leaderSignal.notify_one();
+            }
+        }
+
+        void WakeAssistants()
+        {
+            // Either a parking assistant sees the new epoch, or we see it registered, and it can't
+            // be between its check and its wait while we hold the assist lock.
+            m_assistEpoch.fetch_add(1, std::memory_order_seq_cst);
+
+            if (m_parkedAssistCount.load(std::memory_order_seq_cst) > 0)
+            {
+                std::lock_guard<std::mutex> assistLock(m_assistLock);
+                m_assistSignal.notify_all();
+            }
+        }
+
+        void WakeOne()
+        {
+            m_signalThreads.notify_one();
+
+            if (m_parkedFollowerCount.load(std::memory_order_acquire) == 0)
+            {
+                WakeLeader();
+            }
+
+            WakeAssistants();
+        }
+
+        void WakeAll()
+        {
+            m_signalThreads.notify_all();
+            WakeLeader();
+            WakeAssistants();
+        }
+    };
+
+    inline affinity_t CalculateSafeWorkerAffinity(size_t workerIndex, size_t workerCount)
+    {
+        affinity_t affinity = kAffinityAllBits; // Set all bits so jobs with affinities out of range can still be processed.
+        affinity &= ~(workerCount - 1);         // Wipe bits within valid range.
+        affinity |= GetBit(workerIndex);        // Set worker-specific bit.
+
+        return affinity;
+    }
+
+    /**
+     * Offers access to the state of job.
+     * In particular, callers can use the Wait() function to ensure a given job is complete,
+     * or Cancel().
+     * Note, however, that doing so is not good practice with job systems. If no hardware threads
+     * are available to process a given job, you can stall the caller for significant time.
+     *
+     * Internally, the state manages dependencies as well as atomics describing the status of the job.
+     */
+    typedef std::shared_ptr<class JobState> JobStatePtr;
+
+    class JobSystemWorker;
+
+    /**
+     * Job priorities, most urgent first. High jobs queue ahead of everything else, and background
+     * jobs are the first to be shed when queues overflow (see eQueueOverflowPolicy_DropOldestBackground).
+     * A job's unfinished predecessors inherit its priority when it's readied.
+     */
+    enum EJobPriority
+    {
+        eJobPriority_High,       // Latency-sensitive work.
+        eJobPriority_Normal,     // Regular work.
+        eJobPriority_Background, // Work that may be dropped under overload.
+    };
+
+    /**
+     * A cancellation flag shared by any number of jobs, e.g. a batch of speculative work.
+     * Cancelling is O(1): queued jobs referencing the token are dropped as workers reach them,
+     * and running jobs can poll IsCancelled() to bail out early.
+     * Prefer JobManager::Cancel(), which also wakes idle workers so they drop queued jobs promptly.
+     */
+    class CancellationToken
+    {
+    public:
+        CancellationToken()
+            : m_cancelled(false)
+        {
+        }
+
+        void Cancel()
+        {
+            m_cancelled.store(true, std::memory_order_release);
+        }
+
+        bool IsCancelled() const
+        {
+            return m_cancelled.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::atomic<bool> m_cancelled; // Have jobs referencing the token been cancelled?
+    };
+
+    typedef std::shared_ptr<CancellationToken> CancellationTokenPtr;
+
+    class JobState : public std::enable_shared_from_this<JobState>
+    {
+    private:
+        friend class JobSystemWorker;
+        friend class JobManager;
+        friend class AsyncFileReader;
+
+        std::atomic<bool> m_cancel;   // Is the job pending cancellation?
+        std::atomic<bool> m_ready;    // Has the job been marked as ready for processing?
+        std::atomic<bool> m_rejected; // Was the job refused or dropped because the queues were full?
+        std::atomic<bool> m_claimed;  // Has a worker claimed the job for execution? Set until the job is queued.
+
+        JobDelegate m_delegate; // Delegate to invoke for the job. Moved out when the job runs.
+
+        CancellationTokenPtr m_cancellationToken; // Optional token shared with other jobs, which cancels them all.
+
+        std::exception_ptr m_exception; // Exception thrown by the job (or by the job whose failure cancelled it), rethrown to waiters.
+
+        std::vector<JobStatePtr> m_dependants;              // List of dependent jobs.
+        std::vector<std::weak_ptr<JobState>> m_predecessors; // Jobs this one was made dependent on, for priority inheritance. Guarded by m_doneMutex.
+        std::atomic<int> m_dependencies;                    // Number of outstanding dependencies.
+
+        std::atomic<bool> m_done; // Has the job executed to completion?
+        std::condition_variable m_doneSignal;
+        std::mutex m_doneMutex;
+
+        affinity_t m_workerAffinity; // Option to limit execution to specific worker threads / cores.
+
+        JobSystemContext *m_context; // Owning manager's shared state, for signaling workers. May be null for standalone states.
+        std::atomic<JobSystemWorker *> m_owner; // Worker whose queue holds the job, so cancellation can remove it at once.
+
+        std::atomic<JobSystemWorker *> m_executor; // Worker currently running the job, for waiters to steal its children from.
+        const JobState *m_spawner;                 // Job that was running on the thread that queued this one, if any. Only ever compared, never dereferenced.
+
+        JobStatePtr m_parent;                 // Job whose completion waits on this one (see JobManager::SpawnChild()).
+        std::atomic<int> m_pendingChildren;   // Children yet to complete, plus one while the job itself runs. Only used once it has spawned a child.
+        bool m_hasChildren;                   // Has the running job spawned children? Only touched by the thread running it.
+
+        size_t m_jobId;          // Debug/profiling ID.
+        char m_debugChar;        // Debug character for profiling display.
+        std::atomic<EJobPriority> m_priority; // Priority, for queue order and load shedding. Raised by urgent dependants (see PropagatePriority()).
+        size_t m_costHint;                    // Expected run time in microseconds, or zero if unknown. See SetCostHint().
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+        std::chrono::steady_clock::time_point m_validationTime; // When the job was created, then when it was readied. Guarded by the context's validation lock.
+        bool m_reportedStuck;                                   // Has the watchdog already reported the job? Guarded by the context's validation lock.
+
+        bool CanReach(const JobState *target)
+        {
+            if (this == target)
+            {
+                return true;
+            }
+
+            // Depth-first search through un-finished dependants. Each job's list is copied under its
+            // own lock, so we never hold two jobs' locks at once. Run on every AddDependant(), this makes
+            // building a graph O(E*V), e.g. for large JobChainBuilder fan-outs.
+            std::vector<JobStatePtr> pending;
+            std::unordered_set<const JobState *> visited;
+            visited.insert(this);
+
+            {
+                std::lock_guard<std::mutex> lock(m_doneMutex);
+                pending = m_dependants;
+            }
+
+            while (!pending.empty())
+            {
+                const JobStatePtr job = std::move(pending.back());
+                pending.pop_back();
+
+                if (job.get() == target)
+                {
+                    return true;
+                }
+
+                if (job->IsDone() || !visited.insert(job.get()).second)
+                {
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lock(job->m_doneMutex);
+                pending.insert(pending.end(), job->m_dependants.begin(), job->m_dependants.end());
+            }
+
+            return false;
+        }
+
+        void ValidateDependant(JobState &dependant)
+        {
+            if (dependant.CanReach(this))
+            {
+                fprintf(stderr, "[jobsystem] validation: dependency cycle: job #%zu '%c' -> job #%zu '%c' closes a loop, so neither can run\n",
+                        m_jobId, m_debugChar ? m_debugChar : ' ', dependant.m_jobId, dependant.m_debugChar ? dependant.m_debugChar : ' ');
+                JOBSYSTEM_ASSERT(!"Job dependency cycle");
+            }
+
+            // Edges must be in place before the dependant is readied, otherwise it may already have run.
+            if (!IsDone() && dependant.m_ready.load(std::memory_order_acquire))
+            {
+                fprintf(stderr, "[jobsystem] validation: late edge: job #%zu '%c' gained a dependency on job #%zu '%c' after being readied\n",
+                        dependant.m_jobId, dependant.m_debugChar ? dependant.m_debugChar : ' ', m_jobId, m_debugChar ? m_debugChar : ' ');
+                JOBSYSTEM_ASSERT(!"Dependency added after SetReady()");
+            }
+        }
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+
+        void SetQueued()
+        {
+            m_done.store(false, std::memory_order_release);
+            m_claimed.store(false, std::memory_order_release);
+        }
+
+        bool TryClaim()
+        {
+            // A job can be reached both through its queue entry and as a released dependant (see
+            // SetDone()); whoever claims it first runs it.
+            return !m_claimed.load(std::memory_order_relaxed) && !m_claimed.exchange(true, std::memory_order_acq_rel);
+        }
+
+        void Run()
+        {
+            // The delegate is moved out first, so a continuation may install a new one while it runs.
+            JobDelegate delegate = std::move(m_delegate);
+            m_delegate = nullptr;
+
+#ifdef JOBSYSTEM_EXCEPTIONS_ENABLED
+
+            // Exceptions are captured at the job boundary rather than escaping the worker thread.
+            // Entering the try block costs nothing unless something is thrown.
+            try
+            {
+                delegate();
+            }
+            catch (...)
+            {
+                OnException(std::current_exception());
+            }
+
+#else
+
+            delegate();
+
+#endif // JOBSYSTEM_EXCEPTIONS_ENABLED
+        }
+
+        void OnException(std::exception_ptr exception)
+        {
+            // Children may fail while the job itself runs (see SetDone()), so the first exception
+            // recorded wins, and only it cancels dependants.
+            std::vector<JobStatePtr> dependants;
+            {
+                std::lock_guard<std::mutex> lock(m_doneMutex);
+
+                if (m_exception)
+                {
+                    return;
+                }
+
+                m_exception = exception;
+
+                if (!m_context || !m_context->m_cancelDependantsOnException)
+                {
+                    return;
+                }
+
+                // We haven't completed, so none of our dependants can have started.
+                dependants = m_dependants;
+            }
+
+            for (const JobStatePtr &dependant : dependants)
+            {
+                dependant->CancelTransitively(exception);
+            }
+        }
+
+        JobState &CancelTransitively(std::exception_ptr cause);
+
+        JobStatePtr SetDone(affinity_t inlineAffinity = 0)
+        {
+            JOBSYSTEM_ASSERT(!IsDone());
+
+            // Returns the first dependant this completion made runnable, if it may run on a worker with
+            // inlineAffinity, already claimed so the caller can run it straight away while its inputs
+            // are still in cache. The caller discards its queue entry (see JobSystemWorker::DiscardClaimedJob()).
+            JobStatePtr readyDependant;
+
+            {
+                // Dependants are released under the done mutex, so AddDependant() can't race completion.
+                std::lock_guard<std::mutex> lock(m_doneMutex);
+
+                for (const JobStatePtr &dependant : m_dependants)
+                {
+                    if (dependant->m_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1 && !readyDependant &&
+                        (inlineAffinity & dependant->m_workerAffinity) != 0 && dependant->m_ready.load(std::memory_order_acquire) &&
+                        !dependant->AwaitingCancellation() && dependant->TryClaim())
+                    {
+                        readyDependant = dependant;
+                    }
+                }
+
+                m_done.store(true, std::memory_order_release);
+                m_doneSignal.notify_all();
+            }
+
+            // Assistants may be waiting on this very job.
+            if (m_context)
+            {
+                m_context->WakeAssistants();
+            }
+
+            // The last child to complete completes its parent, once the parent itself has returned.
+            if (m_parent)
+            {
+                const JobStatePtr parent = std::move(m_parent);
+
+                // A failed child fails its parent, before the parent can complete, so the exception
+                // reaches whoever waits on the subtree.
+                if (m_exception)
+                {
+                    parent->OnException(m_exception);
+                }
+
+                if (parent->m_pendingChildren.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    parent->SetDone();
+
+                    if (parent->m_context)
+                    {
+                        parent->m_context->WakeOne();
+                    }
+                }
+            }
+
+            return readyDependant;
+        }
+
+        bool AwaitingCancellation() const
+        {
+            return m_cancel.load(std::memory_order_relaxed) || (m_cancellationToken && m_cancellationToken->IsCancelled());
+        }
+
+        bool MarkReady()
+        {
+            // Rejected and cancelled jobs have already completed; there's nothing left to release.
+            if (WasRejected() || IsCancelled())
+            {
+                return false;
+            }
+
+            JOBSYSTEM_ASSERT(!IsDone());
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+            if (m_context)
+            {
+                std::lock_guard<std::mutex> lock(m_context->m_validationLock);
+                m_validationTime = std::chrono::steady_clock::now();
+            }
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+
+            m_ready.store(true, std::memory_order_release);
+
+            if (HasDependencies())
+            {
+                PropagatePriority();
+            }
+
+            return true;
+        }
+
+        bool InheritPriority(EJobPriority priority)
+        {
+            // Returns true if the priority was raised.
+            EJobPriority current = m_priority.load(std::memory_order_relaxed);
+
+            while (priority < current)
+            {
+                if (m_priority.compare_exchange_weak(current, priority, std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void CollectPredecessors(std::vector<JobStatePtr> &predecessors)
+        {
+            std::lock_guard<std::mutex> lock(m_doneMutex);
+
+            for (const std::weak_ptr<JobState> &predecessor : m_predecessors)
+            {
+                if (JobStatePtr state = predecessor.lock())
+                {
+                    predecessors.push_back(std::move(state));
+                }
+            }
+        }
+
+        void PropagatePriority();
+
+        void HandToIdleWorker();
+
+        void SetRejected()
+        {
+            // The job never runs, but completes so waiters and dependants aren't stranded.
+            m_rejected.store(true, std::memory_order_relaxed);
+            SetDone();
+        }
+
+    public:
+        explicit JobState(JobSystemContext *context = nullptr)
+            : m_context(context), m_owner(nullptr), m_executor(nullptr), m_spawner(nullptr), m_hasChildren(false), m_debugChar(0), m_priority(eJobPriority_Normal), m_costHint(0)
+        {
+            m_jobId = context ? context->m_nextJobId++ : 0;
+            m_workerAffinity = kAffinityAllBits;
+
+            m_dependencies.store(0, std::memory_order_release);
+            m_pendingChildren.store(0, std::memory_order_release);
+            m_cancel.store(false, std::memory_order_release);
+            m_ready.store(false, std::memory_order_release);
+            m_rejected.store(false, std::memory_order_release);
+            m_claimed.store(true, std::memory_order_release);
+            m_done.store(false, std::memory_order_release);
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+            m_validationTime = std::chrono::steady_clock::now();
+            m_reportedStuck = false;
+
+            if (m_context)
+            {
+                std::lock_guard<std::mutex> lock(m_context->m_validationLock);
+                m_context->m_liveJobs.insert(this);
+            }
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+        }
+
+        ~JobState()
+        {
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+            if (m_context)
+            {
+                std::lock_guard<std::mutex> lock(m_context->m_validationLock);
+                m_context->m_liveJobs.erase(this);
+            }
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+        }
+
+        JobState &SetReady()
+        {
+            if (MarkReady() && m_context)
+            {
+                if (m_context->m_pushToIdle)
+                {
+                    HandToIdleWorker();
+                }
+
+                m_context->WakeAll();
+            }
+
+            return *this;
+        }
+
+        /**
+         * Cancels the job, unless it has already started, along with all of its un-started dependants,
+         * transitively. Cancelled jobs are removed from their queues and complete without running.
+         */
+        JobState &Cancel()
+        {
+            return CancelTransitively(nullptr);
+        }
+
+        bool IsCancelled() const
+        {
+            return m_cancel.load(std::memory_order_acquire);
+        }
+
+        JobState &AddDependant(JobStatePtr dependant)
+        {
+            JOBSYSTEM_ASSERT(m_dependants.end() == std::find(m_dependants.begin(), m_dependants.end(), dependant));
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+            ValidateDependant(*dependant);
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+
+            {
+                std::lock_guard<std::mutex> lock(m_doneMutex);
+
+                m_dependants.push_back(dependant);
+
+                // If we've already completed (e.g. an asynchronous read that finished early), the
+                // dependency is already satisfied.
+                if (IsDone())
+                {
+                    return *this;
+                }
+
+                dependant->m_dependencies.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Recorded under the dependant's own lock, so we never hold two jobs' locks at once.
+            std::lock_guard<std::mutex> dependantLock(dependant->m_doneMutex);
+            dependant->m_predecessors.push_back(shared_from_this());
+
+            return *this;
+        }
+
+        /**
+         * Hints how long the job is expected to run, in microseconds, so threads waiting on other jobs
+         * don't help with it if it would hold them up (see JobManagerDescriptor::m_maxHelpedJobCostMicroseconds).
+         */
+        JobState &SetCostHint(size_t microseconds)
+        {
+            m_costHint = microseconds;
+
+            return *this;
+        }
+
+        JobState &SetWorkerAffinity(affinity_t affinity)
+        {
+            m_workerAffinity = affinity ? affinity : kAffinityAllBits;
+
+            return *this;
+        }
+
+        bool IsDone() const
+        {
+            return m_done.load(std::memory_order_acquire);
+        }
+
+        /**
+         * True if the job completed without running, because the queues were full when it was
+         * added (eQueueOverflowPolicy_Reject), or it was shed to make room for another job.
+         */
+        bool WasRejected() const
+        {
+            return m_rejected.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Waits for the job to complete (or the timeout to elapse; zero waits indefinitely), then
+         * rethrows the exception the job threw, if any.
+         */
+        bool Wait(size_t maxWaitMicroseconds = 0)
+        {
+            if (!IsDone())
+            {
+                std::unique_lock<std::mutex> lock(m_doneMutex);
+
+                if (maxWaitMicroseconds == 0)
+                {
+                    m_doneSignal.wait(lock,
+                                      [this]()
+                                      {
+                                          return IsDone();
+                                      });
+                }
+                else
+                {
+                    m_doneSignal.wait_for(lock, std::chrono::microseconds(maxWaitMicroseconds));
+                }
+            }
+
+            const bool done = IsDone();
+
+            RethrowException();
+
+            return done;
+        }
+
+        /**
+         * The exception thrown by the job or one of its children, if any. Jobs cancelled because a predecessor threw
+         * (see JobManagerDescriptor::m_cancelDependantsOnException) carry the predecessor's exception.
+         * Only meaningful once the job is done.
+         */
+        std::exception_ptr GetException() const
+        {
+            return IsDone() ? m_exception : nullptr;
+        }
+
+        /**
+         * Rethrows the job's exception, if it's done and threw. Wait() does this for you.
+         */
+        void RethrowException() const
+        {
+#ifdef JOBSYSTEM_EXCEPTIONS_ENABLED
+
+            if (IsDone() && m_exception)
+            {
+                std::rethrow_exception(m_exception);
+            }
+
+#endif // JOBSYSTEM_EXCEPTIONS_ENABLED
+        }
+
+        bool AreDependenciesMet() const
+        {
+            if (!m_ready.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            if (m_dependencies.load(std::memory_order_acquire) > 0)
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        bool HasDependencies() const
+        {
+            return (m_dependencies.load(std::memory_order_relaxed) > 0);
+        }
+    };
+
+    /**
+     * Represents an entry in a job queue.
+     * - Internal job state, which holds the delegate to invoke
+     */
+    struct JobQueueEntry
+    {
+        JobStatePtr m_state;                     // Pointer to job state.
+        CancellationToken *m_cancellationToken; // The job's cancellation token, if any, so cancelled entries are dropped without touching the state.
+
+        std::chrono::steady_clock::time_point m_enqueueTime; // When the job was queued. Only recorded if queue latency is monitored.
+    };
+
+    /**
+     * Descriptor for a given job worker thread, to be provided by the host application.
+     */
+    struct JobWorkerDescriptor
+    {
+        JobWorkerDescriptor(const char *name = "JobSystemWorker", affinity_t cpuAffinity = affinity_t(~0), bool enableWorkSteeling = true)
+            : m_name(name), m_cpuAffinity(cpuAffinity), m_enableWorkStealing(enableWorkSteeling)
+        {
+        }
+
+        std::string m_name;            // Worker name, for debug/profiling displays.
+        affinity_t m_cpuAffinity;      // Thread affinity. Defaults to all cores.
+        bool m_enableWorkStealing : 1; // Enable queue-sharing between workers?
+    };
+
+    /**
+     * Job events (for tracking/debugging).
+     */
+    enum EJobEvent
+    {
+        eJobEvent_JobPopped,      // A job was popped from a queue.
+        eJobEvent_JobStart,       // A job is about to start.
+        eJobEvent_JobDone,        // A job just completed.
+        eJobEvent_JobRun,         // A job has been completed.
+        eJobEvent_JobRunAssisted, // A job has been completed through outside assistance.
+        eJobEvent_JobStolen,      // A worker has stolen a job from another worker.
+        eJobEvent_WorkerAwoken,   // A worker has been awoken.
+        eJobEvent_WorkerUsed,     // A worker has been utilized.
+    };
+
+    typedef std::function<void(const JobQueueEntry &job, EJobEvent, uint64_t, size_t)> JobEventObserver; // Delegate definition for job event observation.
+
+    typedef std::deque<JobQueueEntry> JobQueue; // Data structure to represent job queue.
+
+    /**
+     * High-res clock based on windows performance counter. Supports STL chrono interfaces.
+     */
+    using TimePoint = std::chrono::high_resolution_clock::time_point;
+    inline TimePoint ProfileClockNow()
+    {
+        return std::chrono::high_resolution_clock::now();
+    }
+
+    /**
+     * Tracking each job's start/end times in a per-worker timeline, for debugging/profiling.
+     */
+    class ProfilingTimeline
+    {
+    public:
+        struct TimelineEntry
+        {
+            uint64_t jobId;  // ID of the job that generated this timeline entry.
+            TimePoint start; // Job start time.
+            TimePoint end;   // Job end time.
+            char debugChar;  // Job's debug character for profiling display.
+
+            std::string description; // Timeline entry description.
+        };
+
+        typedef std::vector<TimelineEntry> TimelineEntries;
+
+        TimelineEntries m_entries; //< List of timeline entries for this thread.
+    };
+
+    /**
+     * Represents a worker thread.
+     * - Owns a job queue
+     * - Implements work-stealing from other workers
+     * - May be spawned lazily, and may retire when idle and be re-spawned later
+     */
+    class JobSystemWorker
+    {
+        friend class JobManager;
+        friend class JobState;
+
+    public:
+        JobSystemWorker(const JobWorkerDescriptor &desc, const JobEventObserver &eventObserver)
+            : m_stop(false), m_spawned(false), m_spawnChildren(false), m_isSpare(false), m_blockingDepth(0), m_helpingDepth(0), m_currentJob(nullptr), m_completionDeferred(false), m_allWorkers(nullptr), m_workerCount(0), m_workerIndex(0), m_context(nullptr), m_eventObserver(eventObserver), m_desc(desc)
+        {
+        }
+
+        void Init(size_t index, JobSystemWorker **allWorkers, size_t workerCount, JobSystemContext *context, bool spawnChildren)
+        {
+            m_allWorkers = allWorkers;
+            m_workerCount = workerCount;
+            m_workerIndex = index;
+            m_context = context;
+            m_spawnChildren = spawnChildren;
+            m_isSpare = (index >= context->m_computeWorkerCount);
+        }
+
+        static JobSystemWorker *&Current()
+        {
+            // The worker running on the calling thread, if any.
+            static thread_local JobSystemWorker *s_currentWorker = nullptr;
+            return s_currentWorker;
+        }
+
+        bool Spawn()
+        {
+            // Deterministic mode runs jobs only on assisting threads.
+            if (m_context->m_deterministic)
+            {
+                return false;
+            }
+
+            std::lock_guard<std::mutex> spawnLock(m_spawnLock);
+
+            // Once shutdown has requested a stop, Join() may already have passed us, and a thread
+            // spawned now would never be joined. Join() follows RequestStop() and takes this lock, so
+            // if it has run, the stop is visible here.
+            if (m_stop.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+
+            // Only the first caller spawns the thread; lazy, tree and elastic spawning may race to do so.
+            bool expected = false;
+            if (!m_spawned.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+            {
+                return false;
+            }
+
+            // A previously retired thread has already left its loop; reclaim it before replacing it.
+            if (m_thread.joinable())
+            {
+                m_thread.join();
+            }
+
+            std::atomic<size_t> &activeCount = m_isSpare ? m_context->m_activeSpareCount : m_context->m_activeWorkerCount;
+            activeCount.fetch_add(1, std::memory_order_acq_rel);
+            m_thread = std::thread(&JobSystemWorker::WorkerThreadProc, this);
+
+            return true;
+        }
+
+        static bool SpawnDormantWorker(JobSystemWorker **workers, size_t firstIndex, size_t endIndex)
+        {
+            for (size_t i = firstIndex; i < endIndex; ++i)
+            {
+                if (!workers[i]->IsSpawned() && workers[i]->Spawn())
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        bool IsSpawned() const
+        {
+            return m_spawned.load(std::memory_order_acquire);
+        }
+
+        void RequestStop()
+        {
+            // Must be called with the context's signal lock held, so the worker can't miss the stop
+            // between evaluating its wait predicate and parking.
+            m_stop.store(true, std::memory_order_relaxed);
+        }
+
+        void Join()
+        {
+            std::lock_guard<std::mutex> spawnLock(m_spawnLock);
+
+            if (m_thread.joinable())
+            {
+                m_thread.join();
+            }
+        }
+
+        JobStatePtr PushJob(JobDelegate delegate)
+        {
+            JobStatePtr state = std::make_shared<JobState>(m_context);
+            state->m_delegate = std::move(delegate);
+
+            PushJob(state);
+
+            return state;
+        }
+
+        bool PushJob(const JobStatePtr &state, size_t capacity = 0, bool *crossedHighWatermark = nullptr)
+        {
+            // Returns false if the queue already holds capacity jobs. Zero means unbounded.
+            JobQueueEntry entry = {state, state->m_cancellationToken.get(), {}};
+            entry.m_state->m_owner = this;
+            entry.m_state->SetQueued();
+
+            JobSystemWorker *pusher = Current();
+            entry.m_state->m_spawner = (pusher && pusher->m_currentJob) ? pusher->m_currentJob->m_state.get() : nullptr;
+
+            if (m_context->m_spawnQueueLatency.count() > 0)
+            {
+                entry.m_enqueueTime = std::chrono::steady_clock::now();
+            }
+
+            {
+                std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+                if (capacity > 0 && m_queue.size() >= capacity)
+                {
+                    return false;
+                }
+
+                m_queue.insert(QueuePosition(state->m_priority.load(std::memory_order_relaxed)), entry);
+            }
+
+            const bool crossed = m_context->OnJobQueued();
+            if (crossedHighWatermark)
+            {
+                *crossedHighWatermark = crossed;
+            }
+
+            return true;
+        }
+
+        void PushContinuation(JobDelegate delegate)
+        {
+            // The continuation inherits the current job's state, and queues behind everything else
+            // in our queue, so waiting jobs run first.
+            JOBSYSTEM_ASSERT(m_currentJob);
+
+            JobQueueEntry entry = {m_currentJob->m_state, m_currentJob->m_cancellationToken, {}};
+
+            if (m_context->m_spawnQueueLatency.count() > 0)
+            {
+                entry.m_enqueueTime = std::chrono::steady_clock::now();
+            }
+
+            // Our claim on the state is released, so whichever of its entries is popped next runs it.
+            entry.m_state->m_owner = this;
+            entry.m_state->m_delegate = std::move(delegate);
+            entry.m_state->m_claimed.store(false, std::memory_order_release);
+
+            {
+                std::lock_guard<std::mutex> queueLock(m_queueLock);
+                m_queue.push_back(entry);
+            }
+
+            m_context->OnJobQueued();
+            m_completionDeferred = true;
+        }
+
+        bool RunJob(JobQueueEntry &job)
+        {
+            // Returns false if the job yielded, leaving its completion to a continuation, or if it
+            // spawned children that are still running, the last of which completes it.
+            JobQueueEntry *const previousJob = m_currentJob;
+            const bool previousCompletionDeferred = m_completionDeferred;
+
+            m_currentJob = &job;
+            m_completionDeferred = false;
+
+            job.m_state->m_executor.store(this, std::memory_order_release);
+            job.m_state->Run();
+            job.m_state->m_executor.store(nullptr, std::memory_order_release);
+
+            bool completed = !m_completionDeferred;
+
+            if (completed && job.m_state->m_hasChildren)
+            {
+                job.m_state->m_hasChildren = false;
+                completed = (job.m_state->m_pendingChildren.fetch_sub(1, std::memory_order_acq_rel) == 1);
+            }
+
+            m_currentJob = previousJob;
+            m_completionDeferred = previousCompletionDeferred;
+
+            return completed;
+        }
+
+        void PurgeCancelledJobs()
+        {
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+            for (auto jobIter = m_queue.begin(); jobIter != m_queue.end();)
+            {
+                if (jobIter->m_state->IsCancelled() && jobIter->m_state->IsDone())
+                {
+                    jobIter = m_queue.erase(jobIter);
+                    m_context->OnJobDequeued();
+                }
+                else
+                {
+                    ++jobIter;
+                }
+            }
+        }
+
+        bool TryReclaimJob(const JobStatePtr &state)
+        {
+            // Claims a job pushed to our queue that nobody has started, removing its entry, so the
+            // caller can run it inline.
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+            if (!state->TryClaim())
+            {
+                return false;
+            }
+
+            for (auto jobIter = m_queue.begin(); jobIter != m_queue.end(); ++jobIter)
+            {
+                if (jobIter->m_state == state)
+                {
+                    m_queue.erase(jobIter);
+                    m_context->OnJobDequeued();
+                    break;
+                }
+            }
+
+            return true;
+        }
+
+        void DiscardClaimedJob(const JobState *state)
+        {
+            // Removes the entry of a job claimed to run inline (see JobState::SetDone()), so it stops
+            // counting as queued. A pop may already have dropped it.
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+            for (auto jobIter = m_queue.begin(); jobIter != m_queue.end(); ++jobIter)
+            {
+                if (jobIter->m_state.get() == state)
+                {
+                    m_queue.erase(jobIter);
+                    m_context->OnJobDequeued();
+                    break;
+                }
+            }
+        }
+
+        void CollectRunnableJobs(std::vector<JobState *> &runnableJobs)
+        {
+            // For deterministic mode: lists the jobs that could run now, in queue order, regardless of
+            // affinity. Cancelled and stale entries are dropped on the way, as PopJobFromQueue() would.
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+            for (auto jobIter = m_queue.begin(); jobIter != m_queue.end();)
+            {
+                const JobQueueEntry &candidate = (*jobIter);
+
+                const bool cancelled = (candidate.m_cancellationToken && candidate.m_cancellationToken->IsCancelled()) ||
+                                       candidate.m_state->AwaitingCancellation();
+
+                if (cancelled || (candidate.m_state->AreDependenciesMet() && candidate.m_state->m_claimed.load(std::memory_order_acquire)))
+                {
+                    if (cancelled)
+                    {
+                        CompleteCancelledJob(candidate);
+                    }
+
+                    jobIter = m_queue.erase(jobIter);
+                    m_context->OnJobDequeued();
+
+                    continue;
+                }
+
+                if (candidate.m_state->AreDependenciesMet())
+                {
+                    runnableJobs.push_back(candidate.m_state.get());
+                }
+
+                ++jobIter;
+            }
+        }
+
+        bool HasRunnableJob() const
+        {
+            // True if a worker could pop something from our queue now, so it will be dequeued.
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+            for (const JobQueueEntry &candidate : m_queue)
+            {
+                if (candidate.m_state->AreDependenciesMet() || candidate.m_state->AwaitingCancellation() ||
+                    (candidate.m_cancellationToken && candidate.m_cancellationToken->IsCancelled()))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        bool PopJob(const JobState *state, JobQueueEntry &job)
+        {
+            // Pops a specific job, if it's runnable.
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+            for (auto jobIter = m_queue.begin(); jobIter != m_queue.end(); ++jobIter)
+            {
+                if (jobIter->m_state.get() == state && state->AreDependenciesMet() && !state->AwaitingCancellation() &&
+                    !(jobIter->m_cancellationToken && jobIter->m_cancellationToken->IsCancelled()) && jobIter->m_state->TryClaim())
+                {
+                    job = *jobIter;
+                    m_queue.erase(jobIter);
+                    m_context->OnJobDequeued();
+
+                    NotifyEventObserver(job, eJobEvent_JobPopped, m_workerIndex);
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        JobQueue::iterator QueuePosition(EJobPriority priority)
+        {
+            // Jobs are pushed to the front, where they're popped from first, except that other jobs
+            // stay behind any high priority jobs there. Expects the queue lock to be held.
+            auto position = m_queue.begin();
+
+            if (priority != eJobPriority_High)
+            {
+                while (position != m_queue.end() && position->m_state->m_priority.load(std::memory_order_relaxed) == eJobPriority_High)
+                {
+                    ++position;
+                }
+            }
+
+            return position;
+        }
+
+        void PromoteJob(const JobState *state)
+        {
+            // Moves a job that inherited a higher priority to where its priority would have queued it.
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+            for (auto jobIter = m_queue.begin(); jobIter != m_queue.end(); ++jobIter)
+            {
+                if (jobIter->m_state.get() == state)
+                {
+                    const JobQueueEntry entry = *jobIter;
+                    m_queue.erase(jobIter);
+                    m_queue.insert(QueuePosition(state->m_priority.load(std::memory_order_relaxed)), entry);
+
+                    return;
+                }
+            }
+        }
+
+        bool TakeJob(JobSystemWorker &owner, const JobState *state)
+        {
+            // Moves a queued job nobody has claimed from owner's queue to ours, if ours is empty, as a
+            // parked worker's is. The entry is re-queued as is, so it stays counted as queued.
+            {
+                std::lock_guard<std::mutex> queueLock(m_queueLock);
+                if (!m_queue.empty())
+                {
+                    return false;
+                }
+            }
+
+            JobQueueEntry entry;
+            {
+                std::lock_guard<std::mutex> queueLock(owner.m_queueLock);
+
+                auto jobIter = std::find_if(owner.m_queue.begin(), owner.m_queue.end(), [state](const JobQueueEntry &candidate)
+                                            { return candidate.m_state.get() == state; });
+                if (jobIter == owner.m_queue.end() || state->m_claimed.load(std::memory_order_acquire))
+                {
+                    return false;
+                }
+
+                entry = *jobIter;
+                owner.m_queue.erase(jobIter);
+            }
+
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+            entry.m_state->m_owner = this;
+            m_queue.insert(QueuePosition(entry.m_state->m_priority.load(std::memory_order_relaxed)), entry);
+
+            return true;
+        }
+
+        bool DropOldestBackgroundJob()
+        {
+            // Jobs are pushed to the front, so the oldest reside at the back.
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+            for (auto jobIter = m_queue.rbegin(); jobIter != m_queue.rend(); ++jobIter)
+            {
+                if (jobIter->m_state->m_priority.load(std::memory_order_relaxed) == eJobPriority_Background)
+                {
+                    JobStatePtr state = jobIter->m_state;
+                    m_queue.erase(std::next(jobIter).base());
+                    m_context->OnJobDequeued();
+
+                    // Entries of jobs already claimed elsewhere just go away.
+                    if (state->TryClaim())
+                    {
+                        state->SetRejected();
+                    }
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+    private:
+        void NotifyEventObserver(const JobQueueEntry &job, EJobEvent event, uint64_t workerIndex, size_t jobId = 0)
+        {
+#ifdef JOBSYSTEM_ENABLE_PROFILING
+
+            if (m_eventObserver)
+            {
+                m_eventObserver(job, event, workerIndex, jobId);
+            }
+
+#endif // JOBSYSTEM_ENABLE_PROFILING
+        }
+
+        static uint32_t NextRandom()
+        {
+            // Per-thread xorshift, as several threads may pop through the same (assist) worker.
+            static thread_local uint32_t s_state = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+
+            s_state ^= s_state << 13;
+            s_state ^= s_state >> 17;
+            s_state ^= s_state << 5;
+
+            return s_state;
+        }
+
+        static void CompleteCancelledJob(const JobQueueEntry &entry)
+        {
+            // Whoever reaches a cancelled entry first completes its job, unless it's already been claimed.
+            if (entry.m_state->TryClaim())
+            {
+                entry.m_state->m_cancel.store(true, std::memory_order_release);
+                entry.m_state->m_delegate = nullptr;
+                entry.m_state->SetDone();
+            }
+        }
+
+        bool PopJobFromQueue(JobQueue &queue, JobQueueEntry &job, bool &hasUnsatisfiedDependencies, affinity_t workerAffinity, const JobState *spawner = nullptr, size_t maxCostHint = 0)
+        {
+            // If spawner is given, only its children are considered. If maxCostHint is given, jobs
+            // hinted to run longer are left alone.
+            for (auto jobIter = queue.begin(); jobIter != queue.end();)
+            {
+                const JobQueueEntry &candidate = (*jobIter);
+
+                if ((spawner && candidate.m_state->m_spawner != spawner) || (maxCostHint && candidate.m_state->m_costHint > maxCostHint))
+                {
+                    ++jobIter;
+                    continue;
+                }
+
+                // Jobs of a cancelled token are dropped by whoever reaches them first, regardless of affinity.
+                const bool tokenCancelled = candidate.m_cancellationToken && candidate.m_cancellationToken->IsCancelled();
+
+                if (tokenCancelled || (workerAffinity & candidate.m_state->m_workerAffinity) != 0)
+                {
+                    if (tokenCancelled || candidate.m_state->AwaitingCancellation())
+                    {
+                        CompleteCancelledJob(candidate);
+
+                        jobIter = queue.erase(jobIter);
+                        m_context->OnJobDequeued();
+
+                        continue;
+                    }
+                    else if (candidate.m_state->AreDependenciesMet())
+                    {
+                        // The job may already have been run inline by the worker that released it.
+                        if (!candidate.m_state->TryClaim())
+                        {
+                            jobIter = queue.erase(jobIter);
+                            m_context->OnJobDequeued();
+
+                            continue;
+                        }
+
+                        job = candidate;
+                        queue.erase(jobIter);
+                        m_context->OnJobDequeued();
+
+                        NotifyEventObserver(job, eJobEvent_JobPopped, m_workerIndex);
+
+                        return true;
+                    }
+                }
+
+                hasUnsatisfiedDependencies = true;
+                ++jobIter;
+            }
+
+            return false;
+        }
+
+        bool PopNextJob(JobQueueEntry &job, bool &hasUnsatisfiedDependencies, bool useWorkStealing, affinity_t workerAffinity, const JobState *awaitedJob = nullptr, size_t maxCostHint = 0)
+        {
+            bool foundJob = false;
+
+            // Leapfrogging: a thread waiting on a job that another worker is running first steals that
+            // job's children, from the worker's queue and then the others'. Running those, rather than
+            // unrelated (and possibly much longer) work, shortens the wait and bounds our stack growth.
+            JobSystemWorker *executor = awaitedJob ? awaitedJob->m_executor.load(std::memory_order_acquire) : nullptr;
+
+            if (executor && executor != this && useWorkStealing)
+            {
+                {
+                    std::lock_guard<std::mutex> queueLock(executor->m_queueLock);
+                    foundJob = PopJobFromQueue(executor->m_queue, job, hasUnsatisfiedDependencies, workerAffinity, awaitedJob, maxCostHint);
+                }
+
+                // Children added with AddJob() may have gone round-robin to any queue, so try the rest.
+                const size_t firstVictimIndex = foundJob ? 0 : NextRandom() % m_workerCount;
+
+                for (size_t i = 0; foundJob == false && i < m_workerCount; ++i)
+                {
+                    JobSystemWorker &worker = *m_allWorkers[(firstVictimIndex + i) % m_workerCount];
+
+                    if (&worker == this || &worker == executor)
+                    {
+                        continue;
+                    }
+
+                    std::lock_guard<std::mutex> queueLock(worker.m_queueLock);
+                    foundJob = PopJobFromQueue(worker.m_queue, job, hasUnsatisfiedDependencies, workerAffinity, awaitedJob, maxCostHint);
+                }
+
+                if (foundJob)
+                {
+                    NotifyEventObserver(job, eJobEvent_JobStolen, m_workerIndex);
+
+                    return true;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> queueLock(m_queueLock);
+                foundJob = PopJobFromQueue(m_queue, job, hasUnsatisfiedDependencies, workerAffinity, nullptr, maxCostHint);
+            }
+
+            // Having run out of the awaited job's children, we only take work from our own queue: an
+            // unrelated job stolen from elsewhere could hold us long after the awaited job completes.
+            if (!foundJob && useWorkStealing && !executor)
+            {
+                // Start at a random victim, so thieves don't all converge on the lowest-indexed workers.
+                const size_t firstVictimIndex = NextRandom() % m_workerCount;
+
+                for (size_t i = 0; foundJob == false && i < m_workerCount; ++i)
+                {
+                    JOBSYSTEM_ASSERT(m_allWorkers[(firstVictimIndex + i) % m_workerCount]);
+                    JobSystemWorker &worker = *m_allWorkers[(firstVictimIndex + i) % m_workerCount];
+
+                    if (&worker == this)
+                    {
+                        continue;
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> queueLock(worker.m_queueLock);
+                        foundJob = PopJobFromQueue(worker.m_queue, job, hasUnsatisfiedDependencies, workerAffinity, nullptr, maxCostHint);
+                    }
+                }
+
+                if (foundJob)
+                {
+                    NotifyEventObserver(job, eJobEvent_JobStolen, m_workerIndex);
+                }
+            }
+
+            return foundJob;
+        }
+
+        void Park(std::unique_lock<std::mutex> &signalLock, std::chrono::microseconds timeout)
+        {
+            // Parks until woken, or the timeout elapses (zero waits indefinitely). One parked worker at
+            // a time leads: it shortens its timeout to service the timer wheel and, with a reactor, waits
+            // in epoll_wait(), so I/O readiness and job wakeups share a single wake mechanism. The rest
+            // follow on the condition variable.
+            // While parked, we advertise ourselves as idle, so producers can hand us jobs directly.
+            const affinity_t idleBit = (m_workerIndex < sizeof(affinity_t) * 8) ? GetBit(m_workerIndex) : 0;
+            m_context->m_idleWorkerMask.fetch_or(idleBit, std::memory_order_acq_rel);
+
+            if (m_context->m_hasParkedLeader)
+            {
+                m_context->m_parkedFollowerCount.fetch_add(1, std::memory_order_acq_rel);
+
+                if (timeout.count() == 0)
+                {
+                    m_context->m_signalThreads.wait(signalLock);
+                }
+                else
+                {
+                    m_context->m_signalThreads.wait_for(signalLock, timeout);
+                }
+
+                m_context->m_parkedFollowerCount.fetch_sub(1, std::memory_order_acq_rel);
+                m_context->m_idleWorkerMask.fetch_and(~idleBit, std::memory_order_acq_rel);
+
+                return;
+            }
+
+            m_context->m_hasParkedLeader = true;
+
+            std::chrono::microseconds timerTimeout;
+            const bool timersPending = m_context->m_timers.TimeUntilNextExpiry(timerTimeout);
+            if (timersPending)
+            {
+                timeout = (timeout.count() == 0) ? timerTimeout : std::min(timeout, timerTimeout);
+            }
+
+            if (!timersPending || timerTimeout.count() > 0)
+            {
+                if (JobReactor *reactor = m_context->m_reactor)
+                {
+                    signalLock.unlock();
+
+                    reactor->Wait(timeout, m_readyDelegates);
+
+                    // Ready fds become jobs in our own queue, which we'll pop next.
+                    for (const JobDelegate &delegate : m_readyDelegates)
+                    {
+                        PushJob(delegate)->SetReady();
+                    }
+
+                    m_readyDelegates.clear();
+
+                    signalLock.lock();
+                }
+                else if (timeout.count() == 0)
+                {
+                    m_context->m_leaderSignal.wait(signalLock);
+                }
+                else
+                {
+                    m_context->m_leaderSignal.wait_for(signalLock, timeout);
+                }
+            }
+
+            m_context->m_hasParkedLeader = false;
+            m_context->m_idleWorkerMask.fetch_and(~idleBit, std::memory_order_acq_rel);
+
+            ServiceTimers();
+
+            // Promote a follower to lead while we work, so timers and fds remain serviced.
+            if (m_context->m_reactor || m_context->m_timers.HasPending())
+            {
+                m_context->m_signalThreads.notify_one();
+            }
+        }
+
+        void ServiceTimers()
+        {
+            // Expired timers become jobs in our own queue.
+            if (!m_context->m_timers.IsDue() || !m_context->m_timers.Advance(m_expiredTimers))
+            {
+                return;
+            }
+
+            for (const TimerWheel::ExpiredTimer &expired : m_expiredTimers)
+            {
+                JobStatePtr state = PushJob(expired.delegate);
+                state->m_debugChar = expired.debugChar;
+                state->SetReady();
+            }
+
+            m_expiredTimers.clear();
+        }
+
+        bool TryRetire()
+        {
+            // Holding the queue lock orders retirement against PushJob(): either the push lands
+            // first and we stay, or the pusher observes us retired and re-spawns us.
+            std::lock_guard<std::mutex> queueLock(m_queueLock);
+
+            if (!m_queue.empty())
+            {
+                return false;
+            }
+
+            // Regular workers keep a minimum pool alive; spares only live while workers are blocked.
+            std::atomic<size_t> &activeCounter = m_isSpare ? m_context->m_activeSpareCount : m_context->m_activeWorkerCount;
+            const size_t minActive = m_isSpare ? m_context->m_blockedWorkerCount.load(std::memory_order_acquire) : m_context->m_minActiveWorkers;
+
+            size_t activeCount = activeCounter.load(std::memory_order_acquire);
+            do
+            {
+                if (activeCount <= minActive)
+                {
+                    return false;
+                }
+            } while (!activeCounter.compare_exchange_weak(activeCount, activeCount - 1, std::memory_order_acq_rel));
+
+            m_spawned.store(false, std::memory_order_release);
+
+            return true;
+        }
+
+        void SetThreadName(const char *name)
+        {
+            (void)name;
+
+            pthread_setname_np(pthread_self(), name);
+        }
+
+        void WorkerThreadProc()
+        {
+            Current() = this;
+
+            SetThreadName(m_desc.m_name.c_str());
+
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            for (size_t i = 0; i < sizeof(m_desc.m_cpuAffinity) * 8; ++i)
+            {
+                if ((1 << i) & m_desc.m_cpuAffinity)
+                {
+                    CPU_SET(i, &cpuset);
+                }
+            }
+
+            const affinity_t workerAffinity = CalculateSafeWorkerAffinity(m_workerIndex, m_workerCount);
+
+            // When spawning as a tree, each worker starts its two children before doing any work,
+            // so bringing up N workers takes O(log N) sequential thread creations.
+            if (m_spawnChildren)
+            {
+                m_spawnChildren = false;
+
+                for (size_t childIndex = m_workerIndex * 2 + 1; childIndex <= m_workerIndex * 2 + 2 && childIndex < m_context->m_computeWorkerCount; ++childIndex)
+                {
+                    m_allWorkers[childIndex]->Spawn();
+                }
+            }
+
+            const std::chrono::microseconds idleRetirePeriod = m_context->m_idleRetirePeriod;
+            const std::chrono::microseconds spawnQueueLatency = m_context->m_spawnQueueLatency;
+
+            auto lastJobTime = std::chrono::steady_clock::now();
+
+            JobStatePtr inlineJob; // Dependant released by our last job, to run next without a queue round trip.
+
+            while (true)
+            {
+                JobQueueEntry job;
+                bool retired = false;
+
+                if (inlineJob)
+                {
+                    job.m_state = std::move(inlineJob);
+                }
+                else
+                {
+                    std::unique_lock<std::mutex> signalLock(m_context->m_signalLock);
+
+                    bool hasUnsatisfiedDependencies;
+
+                    while (!m_stop.load(std::memory_order_relaxed) &&
+                           !PopNextJob(job, hasUnsatisfiedDependencies, m_desc.m_enableWorkStealing, workerAffinity))
+                    {
+                        if (m_isSpare)
+                        {
+                            // Spares retire as soon as the workers they stand in for return, and
+                            // BlockingScope broadcasts when that happens.
+                            if (TryRetire())
+                            {
+                                retired = true;
+                                break;
+                            }
+
+                            m_context->m_signalThreads.wait(signalLock);
+                        }
+                        else if (idleRetirePeriod.count() == 0)
+                        {
+                            Park(signalLock, std::chrono::microseconds(0));
+                        }
+                        else
+                        {
+                            // Wake at least once per retire period, so idleness is noticed even without signals.
+                            Park(signalLock, idleRetirePeriod);
+
+                            if (std::chrono::steady_clock::now() - lastJobTime >= idleRetirePeriod && TryRetire())
+                            {
+                                retired = true;
+                                break;
+                            }
+                        }
+
+                        NotifyEventObserver(job, eJobEvent_WorkerAwoken, m_workerIndex);
+                    }
+                }
+
+                if (retired || m_stop.load(std::memory_order_relaxed))
+                {
+                    break;
+                }
+
+                if (spawnQueueLatency.count() > 0 || idleRetirePeriod.count() > 0)
+                {
+                    lastJobTime = std::chrono::steady_clock::now();
+
+                    // Jobs waiting too long in queues means we're short on workers. Inline jobs never queued.
+                    if (spawnQueueLatency.count() > 0 && job.m_enqueueTime.time_since_epoch().count() != 0 &&
+                        lastJobTime - job.m_enqueueTime > spawnQueueLatency)
+                    {
+                        SpawnDormantWorker(m_allWorkers, 0, m_context->m_computeWorkerCount);
+                    }
+                }
+
+                m_context->m_busyWorkerCount.fetch_add(1, std::memory_order_acq_rel);
+                {
+                    NotifyEventObserver(job, eJobEvent_WorkerUsed, m_workerIndex);
+
+                    NotifyEventObserver(job, eJobEvent_JobStart, m_workerIndex, job.m_state->m_jobId);
+                    const bool completed = RunJob(job);
+                    NotifyEventObserver(job, eJobEvent_JobDone, m_workerIndex);
+
+                    if (completed)
+                    {
+                        inlineJob = job.m_state->SetDone(workerAffinity);
+
+                        JobSystemWorker *inlineOwner = inlineJob ? inlineJob->m_owner.load() : nullptr;
+                        if (inlineOwner)
+                        {
+                            inlineOwner->DiscardClaimedJob(inlineJob.get());
+                        }
+                    }
+
+                    NotifyEventObserver(job, eJobEvent_JobRun, m_workerIndex);
+
+                    m_context->WakeOne();
+                }
+                m_context->m_busyWorkerCount.fetch_sub(1, std::memory_order_acq_rel);
+
+                // Keep timers firing on time even while no worker is idle.
+                ServiceTimers();
+
+                if (m_isSpare && TryRetire())
+                {
+                    break;
+                }
+            }
+
+            Current() = nullptr;
+        }
+
+        std::thread m_thread;        // Thread instance for worker.
+        std::atomic<bool> m_stop;    // Has a stop been requested?
+        std::atomic<bool> m_spawned; // Has the worker's thread been spawned?
+        std::mutex m_spawnLock;      // Serializes spawning/joining of m_thread.
+        bool m_spawnChildren;        // Should this worker spawn its children in the spawn tree on startup?
+        bool m_isSpare;              // Is this a spare worker, only spawned while other workers are blocked?
+        size_t m_blockingDepth;      // Nesting depth of BlockingScopes on this worker's thread.
+        size_t m_helpingDepth;       // Nesting depth of helping waits (see JobManager::AssistUntilJobDone()) on this worker's thread.
+
+        JobQueueEntry *m_currentJob; // Job currently executing on this worker's thread, if any.
+        bool m_completionDeferred;   // Has the current job handed its completion to a continuation?
+
+        mutable std::mutex m_queueLock; // Mutex to guard worker queue.
+        JobQueue m_queue;               // Queue containing requested jobs.
+
+        std::vector<JobDelegate> m_readyDelegates;             // Scratch list of delegates for ready fds, while leading the reactor.
+        std::vector<TimerWheel::ExpiredTimer> m_expiredTimers; // Scratch list of expired timers, while servicing the timer wheel.
+
+        JobSystemWorker **m_allWorkers; // Pointer to array of all workers, for queue-sharing / work-stealing.
+        size_t m_workerCount;           // Number of total workers (size of m_allWorkers array).
+        size_t m_workerIndex;           // This worker's index within m_allWorkers.
+
+        JobSystemContext *m_context; // State shared with the owning job manager and its other workers.
+
+        JobEventObserver m_eventObserver; // Observer of job-related events occurring on this worker.
+        JobWorkerDescriptor m_desc;       // Descriptor/configuration of this worker.
+    };
+
+    inline JobState &JobState::CancelTransitively(std::exception_ptr cause)
+    {
+        // A single pass over the job and everything downstream claims every job that hasn't started,
+        // so none can start; only then are they completed, as completing a job first could release
+        // a dependant to a worker before we reach it. Queue entries are purged per owning worker.
+        // Jobs already running are left to finish, but their dependants are still cancelled.
+        std::vector<JobStatePtr> pending;
+        std::vector<JobStatePtr> cancelled;
+        std::vector<JobSystemWorker *> owners;
+        bool cancelledSelf = false;
+
+        JobStatePtr current; // Keeps the visited state alive, as only its predecessors referenced it.
+        JobState *state = this;
+
+        while (true)
+        {
+            if (!state->IsDone() && !state->IsCancelled())
+            {
+                if (state->TryClaim())
+                {
+                    state->m_cancel.store(true, std::memory_order_release);
+                    state->m_delegate = nullptr;
+                    state->m_exception = cause;
+
+                    if (state->m_owner && owners.end() == std::find(owners.begin(), owners.end(), state->m_owner))
+                    {
+                        owners.push_back(state->m_owner);
+                    }
+
+                    if (state == this)
+                    {
+                        cancelledSelf = true;
+                    }
+                    else
+                    {
+                        cancelled.push_back(current);
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(state->m_doneMutex);
+                pending.insert(pending.end(), state->m_dependants.begin(), state->m_dependants.end());
+            }
+
+            if (pending.empty())
+            {
+                break;
+            }
+
+            current = std::move(pending.back());
+            pending.pop_back();
+            state = current.get();
+        }
+
+        if (cancelledSelf)
+        {
+            SetDone();
+        }
+
+        for (const JobStatePtr &cancelledState : cancelled)
+        {
+            cancelledState->SetDone();
+        }
+
+        for (JobSystemWorker *owner : owners)
+        {
+            owner->PurgeCancelledJobs();
+        }
+
+        return *this;
+    }
+
+    inline void JobState::PropagatePriority()
+    {
+        // Unfinished predecessors inherit our priority, transitively, and move up their queues, so an
+        // urgent job isn't left waiting on work queued behind less urgent jobs. Jobs that are already
+        // at least as urgent stop the walk, which bounds it however often it's repeated.
+        const EJobPriority priority = m_priority.load(std::memory_order_relaxed);
+
+        if (priority == eJobPriority_Background)
+        {
+            return;
+        }
+
+        std::vector<JobStatePtr> pending;
+        CollectPredecessors(pending);
+
+        while (!pending.empty())
+        {
+            const JobStatePtr state = std::move(pending.back());
+            pending.pop_back();
+
+            if (state->IsDone() || !state->InheritPriority(priority))
+            {
+                continue;
+            }
+
+            if (JobSystemWorker *owner = state->m_owner)
+            {
+                owner->PromoteJob(state.get());
+            }
+
+            state->CollectPredecessors(pending);
+        }
+    }
+
+    inline void JobState::HandToIdleWorker()
+    {
+        // Moves a job that has just become runnable to a parked worker that hasn't been handed one
+        // yet, so it finds the job in its own queue once woken, rather than stealing it. Jobs still
+        // waiting on dependencies don't take an idle worker; they're handed over when released.
+        JobSystemWorker *owner = m_owner;
+        size_t idleIndex;
+
+        if (!owner || !AreDependenciesMet() || !m_context->TryClaimIdleWorker(idleIndex))
+        {
+            return;
+        }
+
+        JobSystemWorker *worker = (idleIndex < m_context->m_computeWorkerCount) ? owner->m_allWorkers[idleIndex] : nullptr;
+
+        if (worker == owner)
+        {
+            return;
+        }
+
+        if (!worker || !worker->TakeJob(*owner, this))
+        {
+            // The worker is still idle, for the next job.
+            m_context->m_idleWorkerMask.fetch_or(GetBit(idleIndex), std::memory_order_acq_rel);
+            return;
+        }
+
+        // It may have retired since parking.
+        if (!worker->IsSpawned())
+        {
+            worker->Spawn();
+        }
+    }
+
+    /**
+     * What AddJob() does when the job queues are at capacity.
+     */
+    enum EQueueOverflowPolicy
+    {
+        eQueueOverflowPolicy_Block,                // Wait for space. Producers that are workers themselves run queued jobs instead, so they can't starve the queues they wait on.
+        eQueueOverflowPolicy_CallerRuns,           // Run queued jobs on the producer's thread until space frees up.
+        eQueueOverflowPolicy_Reject,               // Return an already-completed state for which JobState::WasRejected() is true.
+        eQueueOverflowPolicy_DropOldestBackground, // Shed the oldest queued background job to make room. Rejects the new job if there is none.
+    };
+
+    /**
+     * How AddJob() distributes jobs among workers.
+     */
+    enum ESubmissionPolicy
+    {
+        eSubmissionPolicy_RoundRobin, // Cycle through the workers' queues. Idle workers steal from busy ones.
+        eSubmissionPolicy_PushToIdle, // Hand each job, once readied with its dependencies met, to a parked worker that hasn't been handed one yet, so it doesn't have to steal. Until then, and with none idle, workers keep the jobs they add in their own queue; other threads fall back to round-robin.
+    };
+
+    /**
+     * Which half of a fork the forking thread runs itself (see JobManager::ForkJoin() and ParallelFor()).
+     */
+    enum ESpawnPolicy
+    {
+        eSpawnPolicy_HelpFirst, // Queue the child and carry on with the continuation. Suits flat fan-outs, which get every child queued up front.
+        eSpawnPolicy_WorkFirst, // Run the child at once, leaving the continuation for thieves. Suits recursive divide-and-conquer, as queues only ever hold O(depth) jobs.
+    };
+
+    /**
+     * One job execution, as recorded in deterministic mode (see JobManagerDescriptor::m_deterministic).
+     * A job that yields appears once per continuation.
+     */
+    struct JobScheduleEntry
+    {
+        JobScheduleEntry()
+            : jobId(0), debugChar(0), startNanoseconds(0), durationNanoseconds(0)
+        {
+        }
+
+        size_t jobId;                      // ID of the job run. IDs are assigned in creation order, so they match between runs of the same program.
+        char debugChar;                    // Job's debug character.
+        uint64_t startNanoseconds;         // Start time, relative to JobManager::Create().
+        uint64_t durationNanoseconds;      // Time spent in the job itself, excluding jobs it ran while assisting.
+        std::vector<size_t> dependantIds;  // IDs of the job's dependants, recorded once it completed.
+    };
+
+    typedef std::vector<JobScheduleEntry> JobSchedule; // Jobs in the order they ran.
+
+    /**
+     * Writes a schedule as text, one job per line, so it can be replayed by a later run (e.g. of
+     * another build, when bisecting a regression).
+     */
+    inline bool SaveSchedule(const JobSchedule &schedule, const char *path)
+    {
+        FILE *file = fopen(path, "w");
+        if (!file)
+        {
+            return false;
+        }
+
+        for (const JobScheduleEntry &entry : schedule)
+        {
+            fprintf(file, "%zu %d %" PRIu64 " %" PRIu64 " %zu", entry.jobId, static_cast<int>(entry.debugChar), entry.startNanoseconds,
+                    entry.durationNanoseconds, entry.dependantIds.size());
+
+            for (size_t dependantId : entry.dependantIds)
+            {
+                fprintf(file, " %zu", dependantId);
+            }
+
+            fprintf(file, "\n");
+        }
+
+        return fclose(file) == 0;
+    }
+
+    inline bool LoadSchedule(JobSchedule &schedule, const char *path)
+    {
+        FILE *file = fopen(path, "r");
+        if (!file)
+        {
+            return false;
+        }
+
+        schedule.clear();
+
+        JobScheduleEntry entry;
+        int debugChar;
+        size_t dependantCount;
+        bool valid = true;
+
+        while (fscanf(file, "%zu %d %" SCNu64 " %" SCNu64 " %zu", &entry.jobId, &debugChar, &entry.startNanoseconds,
+                      &entry.durationNanoseconds, &dependantCount) == 5)
+        {
+            entry.debugChar = static_cast<char>(debugChar);
+            entry.dependantIds.resize(dependantCount);
+
+            for (size_t &dependantId : entry.dependantIds)
+            {
+                valid = valid && fscanf(file, "%zu", &dependantId) == 1;
+            }
+
+            schedule.push_back(entry);
+        }
+
+        valid = valid && feof(file);
+        fclose(file);
+
+        return valid;
+    }
+
+    /**
+     * Predicts how long a recorded schedule would take with workerCount workers, in nanoseconds, by
+     * list scheduling its jobs with their recorded durations and dependencies: whenever a worker is
+     * free, it takes the ready job that started first in the recording. Scheduling overhead and contention
+     * aren't modeled, so compare predictions with each other rather than with real timings.
+     */
+    inline uint64_t SimulateSchedule(const JobSchedule &schedule, size_t workerCount)
+    {
+        const size_t entryCount = schedule.size();
+        workerCount = std::max<size_t>(1, workerCount);
+
+        // Successors of each entry: its continuation, if it yielded, and its recorded dependants.
+        std::unordered_map<size_t, size_t> firstEntryOfJob;
+        std::unordered_map<size_t, size_t> lastEntryOfJob;
+        std::vector<std::vector<size_t>> successors(entryCount);
+        std::vector<size_t> predecessorCounts(entryCount, 0);
+
+        for (size_t i = 0; i < entryCount; ++i)
+        {
+            auto lastIter = lastEntryOfJob.find(schedule[i].jobId);
+            if (lastIter != lastEntryOfJob.end())
+            {
+                successors[lastIter->second].push_back(i);
+                ++predecessorCounts[i];
+            }
+
+            firstEntryOfJob.insert(std::make_pair(schedule[i].jobId, i));
+            lastEntryOfJob[schedule[i].jobId] = i;
+        }
+
+        for (size_t i = 0; i < entryCount; ++i)
+        {
+            for (size_t dependantId : schedule[i].dependantIds)
+            {
+                auto dependantIter = firstEntryOfJob.find(dependantId);
+                if (dependantIter != firstEntryOfJob.end() && dependantIter->second != i)
+                {
+                    successors[i].push_back(dependantIter->second);
+                    ++predecessorCounts[dependantIter->second];
+                }
+            }
+        }
+
+        typedef std::pair<uint64_t, size_t> RunningEntry; // (finish time, entry index)
+
+        std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+        std::priority_queue<RunningEntry, std::vector<RunningEntry>, std::greater<RunningEntry>> running;
+
+        for (size_t i = 0; i < entryCount; ++i)
+        {
+            if (predecessorCounts[i] == 0)
+            {
+                ready.push(i);
+            }
+        }
+
+        uint64_t now = 0;
+        size_t freeWorkerCount = workerCount;
+
+        while (!ready.empty() || !running.empty())
+        {
+            while (freeWorkerCount > 0 && !ready.empty())
+            {
+                running.push(RunningEntry(now + schedule[ready.top()].durationNanoseconds, ready.top()));
+                ready.pop();
+                --freeWorkerCount;
+            }
+
+            const RunningEntry finished = running.top();
+            running.pop();
+
+            now = finished.first;
+            ++freeWorkerCount;
+
+            for (size_t successor : successors[finished.second])
+            {
+                if (--predecessorCounts[successor] == 0)
+                {
+                    ready.push(successor);
+                }
+            }
+        }
+
+        return now;
+    }
+
+    typedef std::function<void(size_t queuedJobCount)> QueueHighWatermarkCallback; // Delegate definition for queue high watermark notifications.
+
+    /**
+     * Descriptor for configuring the job manager.
+     * - Contains descriptor for each worker
+     */
+    struct JobManagerDescriptor
+    {
+        JobManagerDescriptor()
+            : m_lazyWorkerSpawn(false), m_treeWorkerSpawn(false), m_enableReactor(false), m_spareWorkerCount(0), m_minActiveWorkers(1), m_spawnQueueDepthPerWorker(1), m_workerIdleRetireMicroseconds(0), m_spawnQueueLatencyMicroseconds(0), m_asyncIoThreadCount(2), m_asyncIoQueueDepth(64), m_timerResolutionMicroseconds(1000), m_cancelDependantsOnException(false), m_workerQueueCapacity(0), m_totalQueueCapacity(0), m_queueOverflowPolicy(eQueueOverflowPolicy_Block), m_queueHighWatermark(0), m_watchdogTimeoutMicroseconds(0), m_submissionPolicy(eSubmissionPolicy_RoundRobin), m_deterministic(false), m_deterministicSeed(1), m_maxHelpingDepth(0), m_maxHelpedJobCostMicroseconds(0)
+        {
+        }
+
+        std::vector<JobWorkerDescriptor> m_workers; // Configurations for all workers that should be spawned by JobManager.
+
+        bool m_lazyWorkerSpawn; // Spawn worker threads on demand as queue depth grows, rather than all up front in Create().
+        bool m_treeWorkerSpawn; // Have workers spawn their siblings in a binary tree, rather than Create() spawning all serially.
+
+        bool m_enableReactor; // Create an epoll reactor, so fd readiness can trigger jobs (see JobManager::RegisterFd()).
+
+        size_t m_spareWorkerCount; // Extra workers that are only activated while regular workers are inside a BlockingScope.
+
+        size_t m_minActiveWorkers;              // Idle workers never retire below this count.
+        size_t m_spawnQueueDepthPerWorker;      // Spawn another worker once queued jobs reach this many per active worker.
+        size_t m_workerIdleRetireMicroseconds;  // Retire workers that have been idle this long. Zero keeps workers alive forever.
+        size_t m_spawnQueueLatencyMicroseconds; // Spawn another worker when a job waited in a queue longer than this. Zero disables.
+
+        size_t m_asyncIoThreadCount; // Blocking I/O threads used by ReadFileAsync() when io_uring is unavailable.
+        size_t m_asyncIoQueueDepth;  // io_uring submission queue depth used by ReadFileAsync().
+
+        size_t m_timerResolutionMicroseconds; // Tick length of the timer wheel behind AddJobAfter() / AddPeriodicJob().
+
+        bool m_cancelDependantsOnException; // Cancel the dependants of a job that throws, rather than running them. They rethrow its exception from Wait().
+
+        size_t m_workerQueueCapacity;               // Maximum jobs queued per worker. Zero is unbounded.
+        size_t m_totalQueueCapacity;                // Maximum jobs queued across all workers. Zero is unbounded.
+        EQueueOverflowPolicy m_queueOverflowPolicy; // What AddJob() does when a capacity is reached.
+
+        size_t m_queueHighWatermark;                             // Queued job count at which m_queueHighWatermarkCallback fires. Zero disables.
+        QueueHighWatermarkCallback m_queueHighWatermarkCallback; // Invoked on the producer's thread when the queues rise to the watermark (again, once they've drained to half of it), so producers can shed load upstream.
+
+        size_t m_watchdogTimeoutMicroseconds; // With JOBSYSTEM_ENABLE_VALIDATION, periodically dump jobs that have been stuck this long (see JobManager::DumpStuckJobs()). Zero disables.
+
+        ESubmissionPolicy m_submissionPolicy; // How AddJob() distributes jobs among workers.
+
+        bool m_deterministic;         // Spawn no worker threads. Jobs run one at a time on threads inside Assist*() calls, in an order picked by a generator seeded with m_deterministicSeed, and the schedule is recorded (see JobManager::GetRecordedSchedule()). Blocking waits such as JobState::Wait() never complete in this mode.
+        uint64_t m_deterministicSeed; // Seed for the deterministic scheduler. The same seed and program give the same schedule.
+        JobSchedule m_replaySchedule; // In deterministic mode, run jobs in exactly this recorded order. Divergence is reported, after which the seeded scheduler takes over.
+
+        size_t m_maxHelpingDepth;              // Nesting depth of helping waits (AssistUntilJobDone(), or the joins in ForkJoin() / ParallelFor()) on a thread beyond which it parks rather than running other jobs. It still runs the awaited job and the jobs it depends on, but not its children, so a job waited on beyond the bound shouldn't spawn children while every worker may be waiting too. Zero is unbounded.
+        size_t m_maxHelpedJobCostMicroseconds; // Waiting threads don't help with jobs hinted (see JobState::SetCostHint()) to run longer than this, so they resume promptly. Zero helps with anything.
+    };
+
+    /**
+     * Asynchronous whole-file reads whose completion is represented by a job state, so file I/O can
+     * feed job graphs via AddDependant() without any worker blocking on a read.
+     * - Uses io_uring on Linux (raw syscalls, no liburing dependency)
+     * - Falls back to a small pool of blocking I/O threads if io_uring is unavailable at runtime,
+     *   or JOBSYSTEM_DISABLE_IO_URING is defined
+     */
+    class AsyncFileReader
+    {
+    public:
+        AsyncFileReader(JobSystemContext *context, size_t fallbackThreadCount, size_t queueDepth)
+            : m_context(context), m_stop(false), m_inflightCount(0), m_ringFd(-1)
+        {
+#ifdef JOBSYSTEM_IO_URING_SUPPORTED
+
+            if (InitRing(static_cast<unsigned>(std::max<size_t>(1, queueDepth))))
+            {
+                m_threads.emplace_back(&AsyncFileReader::RingThreadProc, this);
+                return;
+            }
+
+#endif // JOBSYSTEM_IO_URING_SUPPORTED
+
+            (void)queueDepth;
+
+            for (size_t i = 0, n = std::max<size_t>(1, fallbackThreadCount); i < n; ++i)
+            {
+                m_threads.emplace_back(&AsyncFileReader::BlockingThreadProc, this);
+            }
+        }
+
+        ~AsyncFileReader()
+        {
+            // In-flight reads are allowed to complete, so no job state is left pending forever.
+            {
+                std::lock_guard<std::mutex> lock(m_requestLock);
+                m_stop = true;
+            }
+
+            m_requestSignal.notify_all();
+
+#ifdef JOBSYSTEM_IO_URING_SUPPORTED
+
+            if (m_ringFd >= 0)
+            {
+                std::lock_guard<std::mutex> lock(m_requestLock);
+                SubmitNop();
+            }
+
+#endif // JOBSYSTEM_IO_URING_SUPPORTED
+
+            for (std::thread &thread : m_threads)
+            {
+                thread.join();
+            }
+
+#ifdef JOBSYSTEM_IO_URING_SUPPORTED
+
+            ShutdownRing();
+
+#endif // JOBSYSTEM_IO_URING_SUPPORTED
+        }
+
+        bool UsingIoUring() const
+        {
+            return m_ringFd >= 0;
+        }
+
+        JobStatePtr ReadFile(const char *path, std::vector<char> &buffer, int *error)
+        {
+            Request *request = new Request();
+            request->path = path;
+            request->buffer = &buffer;
+            request->error = error;
+            // The state stays claimed, as new states are, so Cancel() treats the read like a running
+            // job: it can't complete the state while the read is in flight, only cancel its dependants.
+            request->state = std::make_shared<JobState>(m_context);
+            request->state->SetReady();
+
+            JobStatePtr state = request->state;
+
+            {
+                std::lock_guard<std::mutex> lock(m_requestLock);
+
+                JOBSYSTEM_ASSERT(!m_stop);
+
+#ifdef JOBSYSTEM_IO_URING_SUPPORTED
+
+                if (m_ringFd >= 0)
+                {
+                    if (!SubmitOrDefer(request))
+                    {
+                        Complete(request, EIO);
+                    }
+
+                    return state;
+                }
+
+#endif // JOBSYSTEM_IO_URING_SUPPORTED
+
+                m_requests.push_back(request);
+            }
+
+            m_requestSignal.notify_one();
+
+            return state;
+        }
+
+    private:
+        enum ERequestStage
+        {
+            eRequestStage_Open, // Waiting for the file to open.
+            eRequestStage_Read, // Waiting for a read into the buffer.
+        };
+
+        struct Request
+        {
+            Request()
+                : buffer(nullptr), error(nullptr), fd(-1), fileSize(0), bytesRead(0), stage(eRequestStage_Open)
+            {
+            }
+
+            std::string path;          // File to read.
+            std::vector<char> *buffer; // Caller's destination buffer. Resized to the file's contents.
+            int *error;                // Optional caller's destination for 0 or an errno value.
+            JobStatePtr state;         // Job state completed once the read finishes.
+
+            int fd;              // Open file descriptor, once opened.
+            size_t fileSize;     // Size of the file, once opened.
+            size_t bytesRead;    // Bytes read so far.
+            ERequestStage stage; // Current stage of the request.
+        };
+
+        void Complete(Request *request, int error)
+        {
+            if (request->fd >= 0)
+            {
+                close(request->fd);
+            }
+
+            if (error)
+            {
+                request->buffer->clear();
+            }
+            else
+            {
+                request->buffer->resize(request->bytesRead);
+            }
+
+            if (request->error)
+            {
+                *request->error = error;
+            }
+
+            request->state->SetDone();
+
+            // Dependants may have become runnable. Pass through the signal lock so a worker can't
+            // miss the wakeup between evaluating its wait predicate and parking.
+            {
+                std::lock_guard<std::mutex> signalLock(m_context->m_signalLock);
+            }
+            m_context->WakeAll();
+
+            delete request;
+        }
+
+        int OpenAndSize(Request *request)
+        {
+            // Returns 0 or an errno value, leaving the buffer sized to the file.
+            struct stat fileStat;
+            if (fstat(request->fd, &fileStat) != 0)
+            {
+                return errno;
+            }
+
+            request->fileSize = static_cast<size_t>(fileStat.st_size);
+            request->buffer->resize(request->fileSize);
+
+            return 0;
+        }
+
+        void ReadBlocking(Request *request)
+        {
+            request->fd = open(request->path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (request->fd < 0)
+            {
+                Complete(request, errno);
+                return;
+            }
+
+            if (const int error = OpenAndSize(request))
+            {
+                Complete(request, error);
+                return;
+            }
+
+            while (request->bytesRead < request->fileSize)
+            {
+                const ssize_t result = read(request->fd, request->buffer->data() + request->bytesRead, request->fileSize - request->bytesRead);
+                if (result < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                else if (result < 0)
+                {
+                    Complete(request, errno);
+                    return;
+                }
+                else if (result == 0)
+                {
+                    break;
+                }
+
+                request->bytesRead += static_cast<size_t>(result);
+            }
+
+            Complete(request, 0);
+        }
+
+        void BlockingThreadProc()
+        {
+            while (true)
+            {
+                Request *request = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(m_requestLock);
+                    m_requestSignal.wait(lock,
+                                         [this]()
+                                         {
+                                             return m_stop || !m_requests.empty();
+                                         });
+
+                    if (m_requests.empty())
+                    {
+                        return;
+                    }
+
+                    request = m_requests.front();
+                    m_requests.pop_front();
+                }
+
+                ReadBlocking(request);
+            }
+        }
+
+#ifdef JOBSYSTEM_IO_URING_SUPPORTED
+
+        bool InitRing(unsigned entries)
+        {
+            struct io_uring_params params;
+            memset(&params, 0, sizeof(params));
+
+            m_ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+            if (m_ringFd < 0)
+            {
+                return false;
+            }
+
+            // Kernels before 5.6 have rings but can't open or read files through them; they get the
+            // blocking pool instead of failing every read.
+            if (!SupportsOpcodes())
+            {
+                close(m_ringFd);
+                m_ringFd = -1;
+                return false;
+            }
+
+            m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+            const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (singleMmap)
+            {
+                m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+            }
+
+            m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+            m_cqRing = singleMmap ? m_sqRing : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+            m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+            m_sqes = static_cast<struct io_uring_sqe *>(mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES));
+
+            if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || m_sqes == MAP_FAILED)
+            {
+                ShutdownRing();
+                return false;
+            }
+
+            char *sq = static_cast<char *>(m_sqRing);
+            char *cq = static_cast<char *>(m_cqRing);
+
+            m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+            m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            m_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            m_sqEntries = params.sq_entries;
+
+            m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            m_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            m_cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+            return true;
+        }
+
+        bool SupportsOpcodes() const
+        {
+            // Opcode probing itself arrived in 5.6, along with IORING_OP_OPENAT and IORING_OP_READ.
+            const size_t kProbeOpCount = 256;
+            std::vector<char> storage(sizeof(struct io_uring_probe) + kProbeOpCount * sizeof(struct io_uring_probe_op), 0);
+            struct io_uring_probe *probe = reinterpret_cast<struct io_uring_probe *>(storage.data());
+
+            if (syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_PROBE, probe, kProbeOpCount) < 0)
+            {
+                return false;
+            }
+
+            for (const uint8_t opcode : {static_cast<uint8_t>(IORING_OP_OPENAT), static_cast<uint8_t>(IORING_OP_READ)})
+            {
+                if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        void ShutdownRing()
+        {
+            if (m_ringFd < 0)
+            {
+                return;
+            }
+
+            if (m_sqes && m_sqes != MAP_FAILED)
+            {
+                munmap(m_sqes, m_sqesSize);
+            }
+
+            if (m_cqRing && m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+            {
+                munmap(m_cqRing, m_cqRingSize);
+            }
+
+            if (m_sqRing && m_sqRing != MAP_FAILED)
+            {
+                munmap(m_sqRing, m_sqRingSize);
+            }
+
+            close(m_ringFd);
+            m_ringFd = -1;
+        }
+
+        struct io_uring_sqe *PrepareSqe(uint8_t opcode, uint64_t userData)
+        {
+            // Must be called with m_requestLock held. Returns null if the submission ring is full.
+            const unsigned tail = *m_sqTail;
+            if (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries)
+            {
+                return nullptr;
+            }
+
+            struct io_uring_sqe *sqe = &m_sqes[tail & m_sqMask];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = opcode;
+            sqe->user_data = userData;
+
+            return sqe;
+        }
+
+        void SubmitSqe()
+        {
+            // Must be called with m_requestLock held, after PrepareSqe() succeeded. Once the tail is
+            // published the entry belongs to the ring, so it counts as submitted even if entering the
+            // kernel fails; it's then picked up by the next enter (see RingThreadProc()).
+            const unsigned tail = *m_sqTail;
+            const unsigned index = tail & m_sqMask;
+
+            m_sqArray[index] = index;
+            __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+            FlushSqes(0);
+        }
+
+        int FlushSqes(unsigned flags)
+        {
+            // Hands the kernel every published entry it hasn't consumed yet, optionally waiting for a
+            // completion (flags = IORING_ENTER_GETEVENTS).
+            const unsigned pending = __atomic_load_n(m_sqTail, __ATOMIC_ACQUIRE) - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+            if (pending == 0 && flags == 0)
+            {
+                return 0;
+            }
+
+            int result;
+            do
+            {
+                result = static_cast<int>(syscall(__NR_io_uring_enter, m_ringFd, pending, flags ? 1 : 0, flags, nullptr, 0));
+            } while (result < 0 && errno == EINTR && flags == 0);
+
+            return result;
+        }
+
+        void SubmitNop()
+        {
+            // A request-less completion, used to wake the ring thread.
+            if (PrepareSqe(IORING_OP_NOP, 0))
+            {
+                SubmitSqe();
+            }
+        }
+
+        bool SubmitRequest(Request *request)
+        {
+            // Must be called with m_requestLock held. Only fails, leaving nothing in the ring, if there
+            // was no free submission entry.
+            const uint8_t opcode = (request->stage == eRequestStage_Open) ? IORING_OP_OPENAT : IORING_OP_READ;
+
+            struct io_uring_sqe *sqe = PrepareSqe(opcode, reinterpret_cast<uint64_t>(request));
+            if (!sqe)
+            {
+                return false;
+            }
+
+            if (request->stage == eRequestStage_Open)
+            {
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<uint64_t>(request->path.c_str());
+                sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            }
+            else
+            {
+                sqe->fd = request->fd;
+                sqe->addr = reinterpret_cast<uint64_t>(request->buffer->data() + request->bytesRead);
+                sqe->len = static_cast<unsigned>(std::min<size_t>(request->fileSize - request->bytesRead, 1u << 30));
+                sqe->off = request->bytesRead;
+            }
+
+            SubmitSqe();
+
+            return true;
+        }
+
+        bool SubmitOrDefer(Request *request)
+        {
+            // Must be called with m_requestLock held. Each request has at most one operation in flight,
+            // so bounding in-flight requests by the ring size guarantees submission never overflows.
+            if (m_inflightCount >= m_sqEntries)
+            {
+                m_requests.push_back(request);
+                return true;
+            }
+
+            if (!SubmitRequest(request))
+            {
+                return false;
+            }
+
+            ++m_inflightCount;
+            return true;
+        }
+
+        void HandleCompletion(Request *request, int result)
+        {
+            // Called on the ring thread, without m_requestLock held. Returns with the request either
+            // completed, or resubmitted for its next stage.
+            if (result == -EINTR || result == -EAGAIN)
+            {
+                result = 0;
+            }
+            else if (result < 0)
+            {
+                Complete(request, -result);
+                return;
+            }
+            else if (request->stage == eRequestStage_Open)
+            {
+                request->fd = result;
+                request->stage = eRequestStage_Read;
+
+                if (const int error = OpenAndSize(request))
+                {
+                    Complete(request, error);
+                    return;
+                }
+
+                result = 0;
+            }
+            else if (result == 0)
+            {
+                // Unexpected EOF (the file shrank). Return what we have.
+                Complete(request, 0);
+                return;
+            }
+
+            request->bytesRead += static_cast<size_t>(result);
+
+            if (request->stage == eRequestStage_Read && request->bytesRead >= request->fileSize)
+            {
+                Complete(request, 0);
+                return;
+            }
+
+            bool submitted;
+            {
+                std::lock_guard<std::mutex> lock(m_requestLock);
+                submitted = SubmitOrDefer(request);
+            }
+
+            if (!submitted)
+            {
+                Complete(request, EIO);
+            }
+        }
+
+        void RingThreadProc()
+        {
+            while (true)
+            {
+                // Also submits anything a failed enter left behind in the submission ring.
+                if (FlushSqes(IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+
+                unsigned head = *m_cqHead;
+                const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+                for (; head != tail; ++head)
+                {
+                    const struct io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+
+                    if (Request *request = reinterpret_cast<Request *>(cqe.user_data))
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock(m_requestLock);
+                            --m_inflightCount;
+                        }
+
+                        HandleCompletion(request, cqe.res);
+                    }
+                }
+
+                __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+                std::lock_guard<std::mutex> lock(m_requestLock);
+
+                // Submit deferred requests now that ring capacity has been returned.
+                while (!m_requests.empty() && m_inflightCount < m_sqEntries)
+                {
+                    Request *request = m_requests.front();
+                    m_requests.pop_front();
+
+                    if (SubmitRequest(request))
+                    {
+                        ++m_inflightCount;
+                    }
+                    else
+                    {
+                        m_requests.push_front(request);
+                        break;
+                    }
+                }
+
+                if (m_stop && m_inflightCount == 0 && m_requests.empty())
+                {
+                    return;
+                }
+            }
+        }
+
+#endif // JOBSYSTEM_IO_URING_SUPPORTED
+
+        JobSystemContext *m_context; // Context of the owning job manager, for waking workers on completion.
+
+        std::mutex m_requestLock;                // Guards the request queue, submission and shutdown.
+        std::condition_variable m_requestSignal; // Signals blocking I/O threads of new requests.
+        std::deque<Request *> m_requests;        // Requests waiting for a blocking I/O thread, or for io_uring capacity.
+        bool m_stop;                             // Has shutdown been requested?
+        size_t m_inflightCount;                  // Number of requests with an io_uring operation in flight.
+
+        std::vector<std::thread> m_threads; // io_uring completion thread, or blocking I/O threads.
+
+        int m_ringFd; // io_uring instance, or -1 if using blocking I/O threads.
+
+#ifdef JOBSYSTEM_IO_URING_SUPPORTED
+
+        void *m_sqRing;              // Mapped submission ring.
+        void *m_cqRing;              // Mapped completion ring (may alias m_sqRing).
+        struct io_uring_sqe *m_sqes; // Mapped submission entries.
+        size_t m_sqRingSize;         // Size of the m_sqRing mapping.
+        size_t m_cqRingSize;         // Size of the m_cqRing mapping.
+        size_t m_sqesSize;           // Size of the m_sqes mapping.
+        unsigned *m_sqHead;          // Submission ring head (consumed by the kernel).
+        unsigned *m_sqTail;          // Submission ring tail (produced by us).
+        unsigned *m_sqArray;         // Submission ring index array.
+        unsigned m_sqMask;           // Submission ring index mask.
+        unsigned m_sqEntries;        // Submission ring capacity.
+        unsigned *m_cqHead;          // Completion ring head (consumed by us).
+        unsigned *m_cqTail;          // Completion ring tail (produced by the kernel).
+        unsigned m_cqMask;           // Completion ring index mask.
+        struct io_uring_cqe *m_cqes; // Completion ring entries.
+
+#endif // JOBSYSTEM_IO_URING_SUPPORTED
+    };
+
+    /**
+     * Manages job workers, and acts as the primary interface to the job queue.
+     */
+    class JobManager
+    {
+    private:
+        void Observer(const JobQueueEntry &job, EJobEvent event, uint64_t workerIndex, size_t jobId = 0)
+        {
+#ifdef JOBSYSTEM_ENABLE_PROFILING
+            switch (event)
+            {
+            case eJobEvent_JobRun:
+            {
+                ++m_jobsRun;
+            }
+            break;
+
+            case eJobEvent_JobStolen:
+            {
+                ++m_jobsStolen;
+            }
+            break;
+
+            case eJobEvent_JobRunAssisted:
+            {
+                ++m_jobsAssisted;
+                ++m_jobsRun;
+            }
+            break;
+
+            case eJobEvent_WorkerAwoken:
+            {
+                m_awokenMask |= GetBit(workerIndex);
+            }
+            break;
+
+            case eJobEvent_WorkerUsed:
+            {
+                m_usedMask |= GetBit(workerIndex);
+            }
+            break;
+
+            case eJobEvent_JobStart:
+            {
+                ProfilingTimeline &timeline = m_timelines[std::min<size_t>(workerIndex, m_workers.size() - 1)];
+                ProfilingTimeline::TimelineEntry entry;
+                entry.jobId = jobId;
+                entry.start = ProfileClockNow();
+                entry.debugChar = job.m_state ? job.m_state->m_debugChar : 0;
+                timeline.m_entries.push_back(entry);
+            }
+            break;
+
+            case eJobEvent_JobDone:
+            {
+                ProfilingTimeline &timeline = m_timelines[std::min<size_t>(workerIndex, m_workers.size() - 1)];
+                ProfilingTimeline::TimelineEntry &entry = timeline.m_entries.back();
+                entry.end = ProfileClockNow();
+            }
+            break;
+
+            case eJobEvent_JobPopped:
+            {
+                if (!m_hasPushedJob)
+                {
+                    m_firstJobTime = ProfileClockNow();
+                    m_hasPushedJob = true;
+                }
+            }
+            break;
+            }
+#endif // JOBSYSTEM_ENABLE_PROFILING
+        }
+
+    public:
+        JobManager()
+            : m_nextRoundRobinWorkerIndex(0), m_jobsRun(0), m_jobsStolen(0), m_usedMask(0), m_awokenMask(0), m_firstJobTime(), m_timelines(nullptr), m_assistWorker(nullptr), m_assistWorkerInUse(false), m_replayPosition(0), m_deterministicRandom(1), m_nestedStepNanoseconds(0)
+        {
+        }
+
+        ~JobManager()
+        {
+            DumpProfilingResults();
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+            // Jobs that were never readied can never run, and whoever is waiting on them never wakes.
+            {
+                std::lock_guard<std::mutex> lock(m_context.m_validationLock);
+
+                for (JobState *job : m_context.m_liveJobs)
+                {
+                    if (!job->m_ready.load(std::memory_order_acquire) && !job->IsDone())
+                    {
+                        fprintf(stderr, "[jobsystem] validation: orphaned job #%zu '%c' was never readied\n", job->m_jobId, job->m_debugChar ? job->m_debugChar : ' ');
+                    }
+                }
+            }
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+
+            JoinWorkersAndShutdown();
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+            // Detach any states that outlive us, so they don't reach back into our context.
+            std::lock_guard<std::mutex> lock(m_context.m_validationLock);
+
+            for (JobState *job : m_context.m_liveJobs)
+            {
+                job->m_context = nullptr;
+            }
+
+            m_context.m_liveJobs.clear();
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+        }
+
+        bool Create(const JobManagerDescriptor &desc)
+        {
+            JoinWorkersAndShutdown();
+
+            m_desc = desc;
+
+            // Regular workers are followed by spares, then a thread-less worker whose queue and identity
+            // are used by threads assisting from outside the pool.
+            const size_t computeWorkerCount = desc.m_workers.size();
+            const size_t workerCount = computeWorkerCount ? computeWorkerCount + desc.m_spareWorkerCount + 1 : 0;
+            m_workers.reserve(workerCount);
+
+#ifdef JOBSYSTEM_ENABLE_PROFILING
+
+            m_timelines = new ProfilingTimeline[workerCount];
+            m_hasPushedJob = false;
+
+#endif // JOBSYSTEM_ENABLE_PROFILING
+
+            const JobEventObserver observer = std::bind(
+                &JobManager::Observer, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
+
+            // Create workers. We don't spawn the threads yet.
+            const JobWorkerDescriptor spareDesc("SpareWorker");
+            const JobWorkerDescriptor assistDesc("[Assist]");
+            for (size_t i = 0; i < workerCount; ++i)
+            {
+                const JobWorkerDescriptor &workerDesc = (i < computeWorkerCount) ? desc.m_workers[i] : (i + 1 < workerCount) ? spareDesc : assistDesc;
+
+                JobSystemWorker *worker = new JobSystemWorker(workerDesc, observer);
+                m_workers.push_back(worker);
+            }
+
+            m_assistWorker = m_workers.empty() ? nullptr : m_workers.back();
+            m_assistWorkerInUse.store(false, std::memory_order_relaxed);
+
+            m_context.m_queuedJobCount.store(0, std::memory_order_relaxed);
+            m_context.m_activeWorkerCount.store(0, std::memory_order_relaxed);
+            m_context.m_computeWorkerCount = computeWorkerCount;
+            m_context.m_blockedWorkerCount.store(0, std::memory_order_relaxed);
+            m_context.m_activeSpareCount.store(0, std::memory_order_relaxed);
+            m_context.m_minActiveWorkers = std::max<size_t>(1, desc.m_minActiveWorkers);
+            m_context.m_spawnQueueDepthPerWorker = std::max<size_t>(1, desc.m_spawnQueueDepthPerWorker);
+            m_context.m_idleRetirePeriod = std::chrono::microseconds(desc.m_workerIdleRetireMicroseconds);
+            m_context.m_spawnQueueLatency = std::chrono::microseconds(desc.m_spawnQueueLatencyMicroseconds);
+            m_context.m_queueHighWatermark = desc.m_queueHighWatermark;
+            m_context.m_cancelDependantsOnException = desc.m_cancelDependantsOnException;
+            m_context.m_deterministic = desc.m_deterministic;
+            m_context.m_pushToIdle = (desc.m_submissionPolicy == eSubmissionPolicy_PushToIdle);
+
+            // Job IDs identify jobs in recorded schedules, so they must restart with each run.
+            if (desc.m_deterministic)
+            {
+                m_context.m_nextJobId.store(0, std::memory_order_relaxed);
+            }
+
+            m_recordedSchedule.clear();
+            m_replayPosition = 0;
+            m_deterministicRandom = desc.m_deterministicSeed ? desc.m_deterministicSeed : 1;
+            m_deterministicStartTime = std::chrono::steady_clock::now();
+            m_nestedStepNanoseconds = 0;
+            m_context.m_aboveHighWatermark.store(false, std::memory_order_relaxed);
+
+            if (desc.m_enableReactor)
+            {
+                m_reactor.reset(new JobReactor());
+                if (!m_reactor->Create())
+                {
+                    m_reactor.reset();
+                }
+            }
+
+            m_context.m_reactor = m_reactor.get();
+            m_context.m_hasParkedLeader = false;
+            m_context.m_parkedFollowerCount.store(0, std::memory_order_relaxed);
+            m_context.m_idleWorkerMask.store(0, std::memory_order_relaxed);
+            m_context.m_parkedAssistCount.store(0, std::memory_order_relaxed);
+            m_context.m_timers.Reset(std::chrono::microseconds(desc.m_timerResolutionMicroseconds));
+
+            // Each worker maintains understanding of what other workers exist, for work-stealing purposes.
+            // The worker array is sized for the maximum worker count and never changes until the next
+            // Create(), so stealing never races with resizing; retired workers simply leave their slot dormant.
+            const bool treeSpawn = desc.m_treeWorkerSpawn && !desc.m_lazyWorkerSpawn;
+            for (size_t i = 0; i < workerCount; ++i)
+            {
+                m_workers[i]->Init(i, &m_workers[0], workerCount, &m_context, treeSpawn);
+            }
+
+            // Spawn threads. Lazy mode defers this to AddJob(), and tree mode only spawns the root,
+            // which spawns the rest. Spares are spawned by BlockingScope.
+            if (!m_workers.empty() && !desc.m_lazyWorkerSpawn)
+            {
+                const size_t spawnCount = treeSpawn ? 1 : computeWorkerCount;
+                for (size_t i = 0; i < spawnCount; ++i)
+                {
+                    m_workers[i]->Spawn();
+                }
+            }
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+            if (!m_workers.empty() && desc.m_watchdogTimeoutMicroseconds > 0)
+            {
+                const size_t timeout = desc.m_watchdogTimeoutMicroseconds;
+                m_watchdogTimer = AddPeriodicJob(std::max<size_t>(1, timeout / 2),
+                                                 [this, timeout]()
+                                                 {
+                                                     DumpStuckJobs(timeout);
+                                                 });
+            }
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+
+            return !m_workers.empty();
+        }
+
+        JobStatePtr AddJob(JobDelegate delegate, char debugChar = 0, EJobPriority priority = eJobPriority_Normal, CancellationTokenPtr cancellationToken = nullptr)
+        {
+            JobStatePtr state = nullptr;
+
+            // \todo - workers should maintain a tls pointer to themselves, so we can push
+            // directly into our own queue.
+
+            if (!m_workers.empty())
+            {
+                state = std::make_shared<JobState>(&m_context);
+                state->m_delegate = std::move(delegate);
+                state->m_debugChar = debugChar;
+                state->m_priority.store(priority, std::memory_order_relaxed);
+                state->m_cancellationToken = std::move(cancellationToken);
+
+                SubmitJob(state);
+            }
+
+            return state;
+        }
+
+        void SubmitJob(const JobStatePtr &state)
+        {
+            SpawnWorkerOnDemand();
+
+            bool crossedHighWatermark = false;
+
+            // Jobs added by an assisting thread (e.g. from jobs it runs) stay in its own queue,
+            // from which idle workers steal.
+            const bool pushed = (JobSystemWorker::Current() == m_assistWorker && m_assistWorker->PushJob(state, m_desc.m_workerQueueCapacity, &crossedHighWatermark)) ||
+                                TryPushJob(state, crossedHighWatermark);
+
+            if (!pushed)
+            {
+                HandleQueueOverflow(state, crossedHighWatermark);
+            }
+
+            if (crossedHighWatermark && m_desc.m_queueHighWatermarkCallback)
+            {
+                m_desc.m_queueHighWatermarkCallback(m_context.m_queuedJobCount.load(std::memory_order_relaxed));
+            }
+        }
+
+        void SpawnWorkerOnDemand()
+        {
+            // Grow the pool by one worker whenever queue depth outgrows the active workers.
+            const size_t activeCount = m_context.m_activeWorkerCount.load(std::memory_order_acquire);
+
+            if (activeCount < m_context.m_computeWorkerCount &&
+                m_context.m_queuedJobCount.load(std::memory_order_relaxed) >= activeCount * m_context.m_spawnQueueDepthPerWorker)
+            {
+                JobSystemWorker::SpawnDormantWorker(&m_workers[0], 0, m_context.m_computeWorkerCount);
+            }
+        }
+
+        void BeginBlocking()
+        {
+            // Only blocking on one of our own workers costs compute capacity.
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            if (!worker || worker->m_context != &m_context || worker->m_blockingDepth++ > 0)
+            {
+                return;
+            }
+
+            const size_t blockedCount = m_context.m_blockedWorkerCount.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+            if (m_context.m_activeSpareCount.load(std::memory_order_acquire) < blockedCount)
+            {
+                JobSystemWorker::SpawnDormantWorker(&m_workers[0], m_context.m_computeWorkerCount, m_context.m_computeWorkerCount + m_desc.m_spareWorkerCount);
+            }
+        }
+
+        void EndBlocking()
+        {
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            if (!worker || worker->m_context != &m_context || --worker->m_blockingDepth > 0)
+            {
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> signalLock(m_context.m_signalLock);
+                m_context.m_blockedWorkerCount.fetch_sub(1, std::memory_order_acq_rel);
+            }
+
+            // Wake parked spares so the surplus can retire.
+            m_context.m_signalThreads.notify_all();
+        }
+
+        /**
+         * The jobs run so far in deterministic mode (see JobManagerDescriptor::m_deterministic), in
+         * order. Pass it back as JobManagerDescriptor::m_replaySchedule to repeat the run exactly, or
+         * to SimulateSchedule() to predict how it would fare with a different number of workers.
+         * Only read it while no thread is assisting.
+         */
+        const JobSchedule &GetRecordedSchedule() const
+        {
+            return m_recordedSchedule;
+        }
+
+        /**
+         * Number of jobs currently residing in worker queues, including ones waiting on dependencies.
+         */
+        size_t GetQueuedJobCount() const
+        {
+            return m_context.m_queuedJobCount.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * For long-running jobs to poll: true when splitting off the remaining work would help, because
+         * jobs are queued while every worker is busy (or this is a background job and anything is
+         * queued), or because idle workers have nothing to steal. Always false outside of jobs run
+         * by this manager's workers.
+         */
+        bool ShouldYield() const
+        {
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            if (!worker || worker->m_context != &m_context || !worker->m_currentJob)
+            {
+                return false;
+            }
+
+            const size_t queuedCount = m_context.m_queuedJobCount.load(std::memory_order_relaxed);
+            const size_t busyCount = m_context.m_busyWorkerCount.load(std::memory_order_relaxed);
+            const size_t activeCount = m_context.m_activeWorkerCount.load(std::memory_order_relaxed) +
+                                       m_context.m_activeSpareCount.load(std::memory_order_relaxed);
+
+            if (queuedCount > 0)
+            {
+                return busyCount >= activeCount || worker->m_currentJob->m_state->m_priority.load(std::memory_order_relaxed) == eJobPriority_Background;
+            }
+
+            return busyCount < activeCount;
+        }
+
+        /**
+         * Called from a running job to finish its work in continuation instead. The continuation
+         * queues behind the worker's other jobs (so idle workers may also steal it), and the job's
+         * state only completes, releasing dependants, once the continuation returns without yielding
+         * again. The current job should return promptly afterwards.
+         * Returns false, without queuing anything, when not called from a job on one of this
+         * manager's workers; the caller should carry on inline.
+         */
+        bool YieldAndContinue(JobDelegate continuation)
+        {
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            if (!worker || worker->m_context != &m_context || !worker->m_currentJob || worker->m_completionDeferred)
+            {
+                return false;
+            }
+
+            worker->PushContinuation(continuation);
+
+            m_context.WakeOne();
+
+            return true;
+        }
+
+        /**
+         * Called from a running job to add a child job that its completion waits on. The job still
+         * returns as usual, without blocking its worker, but only completes, releasing dependants,
+         * once all of its children have completed. Lets a node discover its fan-out at run time, e.g.
+         * one child per visible object, with the node's successors waiting on the whole subtree.
+         * Children share the job's priority and cancellation token, and may spawn children of their
+         * own. An exception thrown by a child is also recorded on the job, unless it already has
+         * one, and cancels the job's dependants if the manager was created to do so.
+         * When not called from a job on one of this manager's workers, the child just runs inline.
+         */
+        JobStatePtr SpawnChild(JobDelegate delegate, char debugChar = 0)
+        {
+            const JobStatePtr parent = BeginSpawningChildren();
+            if (!parent)
+            {
+                JobStatePtr state = std::make_shared<JobState>(&m_context);
+                state->m_delegate = std::move(delegate);
+                state->m_debugChar = debugChar;
+                state->Run();
+                state->SetDone();
+
+                return state;
+            }
+
+            return AddChildJob(parent, std::move(delegate), debugChar);
+        }
+
+        /**
+         * Creates a job without queuing it. It only runs once passed to SpawnChildren(); until then,
+         * dependencies may be added to it as to any other job, and if it's never passed, it's simply
+         * released along with its last reference.
+         */
+        JobStatePtr CreateJob(JobDelegate delegate, char debugChar = 0, EJobPriority priority = eJobPriority_Normal, CancellationTokenPtr cancellationToken = nullptr)
+        {
+            JobStatePtr state = std::make_shared<JobState>(&m_context);
+            state->m_delegate = std::move(delegate);
+            state->m_debugChar = debugChar;
+            state->m_priority.store(priority, std::memory_order_relaxed);
+            state->m_cancellationToken = std::move(cancellationToken);
+
+            return state;
+        }
+
+        /**
+         * Called from a running job to queue and ready jobs made with CreateJob(), such as a sub-graph
+         * built ahead of time, as children of the job (see SpawnChild()). Dependencies among them are
+         * kept. When not called from a job on one of this manager's workers, they're queued as
+         * ordinary jobs and the caller helps until they're all done, so it still completes after them.
+         */
+        void SpawnChildren(const std::vector<JobStatePtr> &jobs)
+        {
+            const JobStatePtr parent = jobs.empty() ? nullptr : BeginSpawningChildren();
+
+            for (const JobStatePtr &job : jobs)
+            {
+                if (parent)
+                {
+                    SubmitChildJob(parent, job);
+                }
+                else
+                {
+                    SubmitJob(job);
+                }
+            }
+
+            for (const JobStatePtr &job : jobs)
+            {
+                job->SetReady();
+            }
+
+            if (!parent)
+            {
+                for (const JobStatePtr &job : jobs)
+                {
+                    AssistUntil(*job);
+                }
+            }
+        }
+
+        /**
+         * Called from a running job to run body as child jobs for as long as condition holds. The
+         * condition is checked up front, then again each time an iteration, including any children
+         * it spawned, has completed. The calling job completes once the loop ends, so its dependants
+         * wait for every iteration, and no jobs are dispatched at all if the condition starts false.
+         * The loop also ends once an iteration throws, its exception failing the calling job.
+         * When not called from a job on one of this manager's workers, the loop just runs inline.
+         */
+        void SpawnLoop(std::function<bool()> condition, JobDelegate body, char debugChar = 0)
+        {
+            if (!condition())
+            {
+                return;
+            }
+
+            const JobStatePtr parent = BeginSpawningChildren();
+            if (!parent)
+            {
+                do
+                {
+                    body();
+                } while (condition());
+
+                return;
+            }
+
+            SpawnLoopIteration(parent, std::move(condition), std::move(body), debugChar);
+        }
+
+        /**
+         * Runs child and continuation in parallel, returning once both are done. Under help-first,
+         * the child is queued and the continuation runs on the calling thread; under work-first it's
+         * the other way around. Either way, the queued half is run inline if nobody has stolen it by
+         * the time the inline half returns, otherwise the caller helps run other jobs until it's done.
+         * Exceptions thrown by either half are rethrown once both are done.
+         */
+        void ForkJoin(JobDelegate child, JobDelegate continuation, ESpawnPolicy policy = eSpawnPolicy_HelpFirst, char debugChar = 0)
+        {
+            const bool workFirst = (policy == eSpawnPolicy_WorkFirst);
+
+            JobStatePtr forked = AddLocalJob(std::move(workFirst ? continuation : child), debugChar);
+            const JobDelegate &inlineHalf = workFirst ? child : continuation;
+
+#ifdef JOBSYSTEM_EXCEPTIONS_ENABLED
+
+            // The forked half may reference the caller's stack, so it's joined before anything propagates.
+            try
+            {
+                inlineHalf();
+            }
+            catch (...)
+            {
+                JoinForked(forked, false);
+                throw;
+            }
+
+#else
+
+            inlineHalf();
+
+#endif // JOBSYSTEM_EXCEPTIONS_ENABLED
+
+            JoinForked(forked, true);
+        }
+
+        /**
+         * Calls body(chunkBegin, chunkEnd) over [begin, end) in chunks of at most grainSize, in parallel,
+         * returning once all are done. Help-first queues every chunk but the last, which runs inline;
+         * work-first splits the range in halves recursively via ForkJoin().
+         */
+        void ParallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)> &body, ESpawnPolicy policy = eSpawnPolicy_HelpFirst)
+        {
+            grainSize = std::max<size_t>(1, grainSize);
+
+            if (end - begin <= grainSize || end <= begin)
+            {
+                if (begin < end)
+                {
+                    body(begin, end);
+                }
+
+                return;
+            }
+
+            if (policy == eSpawnPolicy_WorkFirst)
+            {
+                const size_t middle = begin + (end - begin) / 2;
+
+                ForkJoin([&]()
+                         {
+                             ParallelFor(begin, middle, grainSize, body, policy);
+                         },
+                         [&]()
+                         {
+                             ParallelFor(middle, end, grainSize, body, policy);
+                         },
+                         policy);
+
+                return;
+            }
+
+            std::vector<JobStatePtr> forked;
+            forked.reserve((end - begin) / grainSize + 1);
+
+            size_t chunkBegin = begin;
+            for (; end - chunkBegin > grainSize; chunkBegin += grainSize)
+            {
+                const size_t chunkEnd = chunkBegin + grainSize;
+                forked.push_back(AddLocalJob([&body, chunkBegin, chunkEnd]()
+                                             {
+                                                 body(chunkBegin, chunkEnd);
+                                             }));
+            }
+
+#ifdef JOBSYSTEM_EXCEPTIONS_ENABLED
+
+            std::exception_ptr exception;
+
+            try
+            {
+                body(chunkBegin, end);
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+
+            // Newest first, as those are the least likely to have been stolen.
+            for (auto stateIter = forked.rbegin(); stateIter != forked.rend(); ++stateIter)
+            {
+                JoinForked(*stateIter, false);
+
+                if (!exception)
+                {
+                    exception = (*stateIter)->GetException();
+                }
+            }
+
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+
+#else
+
+            body(chunkBegin, end);
+
+            for (auto stateIter = forked.rbegin(); stateIter != forked.rend(); ++stateIter)
+            {
+                JoinForked(*stateIter, false);
+            }
+
+#endif // JOBSYSTEM_EXCEPTIONS_ENABLED
+        }
+
+        /**
+         * Enqueues delegate as a job once delayMicroseconds have elapsed, without occupying a worker
+         * in the meantime. Timing is accurate to the descriptor's timer resolution.
+         */
+        TimerHandle AddJobAfter(size_t delayMicroseconds, JobDelegate delegate, char debugChar = 0)
+        {
+            return ScheduleTimer(delayMicroseconds, 0, delegate, debugChar);
+        }
+
+        /**
+         * Enqueues delegate as a job every periodMicroseconds, until cancelled via CancelTimer().
+         */
+        TimerHandle AddPeriodicJob(size_t periodMicroseconds, JobDelegate delegate, char debugChar = 0)
+        {
+            return ScheduleTimer(periodMicroseconds, periodMicroseconds, delegate, debugChar);
+        }
+
+        bool CancelTimer(const TimerHandle &timer)
+        {
+            return m_context.m_timers.Cancel(timer);
+        }
+
+        /**
+         * Cancels every job added with the token. Queued jobs complete without running as workers,
+         * which are woken to sweep their queues, reach them.
+         */
+        void Cancel(const CancellationTokenPtr &cancellationToken)
+        {
+            cancellationToken->Cancel();
+
+            m_context.WakeAll();
+        }
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+        /**
+         * Dumps jobs still incomplete olderThanMicroseconds after being readied (or created, if never
+         * readied), with their outstanding dependency counts and un-finished predecessors, to stderr.
+         * Each job is reported once. Runs periodically if JobManagerDescriptor::m_watchdogTimeoutMicroseconds
+         * is set. Returns the number of jobs reported.
+         */
+        size_t DumpStuckJobs(size_t olderThanMicroseconds)
+        {
+            const std::chrono::steady_clock::time_point cutoff = std::chrono::steady_clock::now() - std::chrono::microseconds(olderThanMicroseconds);
+
+            // Declared before the lock, so predecessors we hold the last reference to are destroyed
+            // (and unregistered from m_liveJobs) after it's released.
+            std::vector<JobStatePtr> predecessors;
+
+            std::lock_guard<std::mutex> lock(m_context.m_validationLock);
+
+            std::vector<JobState *> stuckJobs;
+            for (JobState *job : m_context.m_liveJobs)
+            {
+                if (!job->IsDone() && !job->m_reportedStuck && job->m_validationTime <= cutoff)
+                {
+                    stuckJobs.push_back(job);
+                }
+            }
+
+            if (stuckJobs.empty())
+            {
+                return 0;
+            }
+
+            std::sort(stuckJobs.begin(), stuckJobs.end(),
+                      [](const JobState *a, const JobState *b)
+                      {
+                          return a->m_jobId < b->m_jobId;
+                      });
+
+            fprintf(stderr, "[jobsystem] watchdog: %zu job(s) incomplete after %zuus:\n", stuckJobs.size(), olderThanMicroseconds);
+
+            for (JobState *job : stuckJobs)
+            {
+                job->m_reportedStuck = true;
+
+                const char *status = !job->m_ready.load(std::memory_order_acquire) ? "never readied"
+                                     : job->HasDependencies()                      ? "waiting on dependencies"
+                                                                                   : "queued or running";
+
+                fprintf(stderr, "    job #%zu '%c': %s, %d outstanding dependencies", job->m_jobId, job->m_debugChar ? job->m_debugChar : ' ',
+                        status, job->m_dependencies.load(std::memory_order_relaxed));
+
+                const size_t firstPredecessor = predecessors.size();
+                job->CollectPredecessors(predecessors);
+
+                for (size_t predecessorIndex = firstPredecessor; predecessorIndex < predecessors.size(); ++predecessorIndex)
+                {
+                    const JobState *predecessor = predecessors[predecessorIndex].get();
+                    if (predecessor->IsDone())
+                    {
+                        continue;
+                    }
+
+                    fprintf(stderr, " <- #%zu '%c'%s", predecessor->m_jobId, predecessor->m_debugChar ? predecessor->m_debugChar : ' ',
+                            predecessor->m_ready.load(std::memory_order_acquire) ? "" : " (never readied)");
+                }
+
+                fprintf(stderr, "\n");
+            }
+
+            return stuckJobs.size();
+        }
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+
+        /**
+         * Enqueues delegate as a job each time fd becomes ready for the given epoll events (e.g. EPOLLIN).
+         * The registration stays armed until unregistered, but never has more than one job in flight.
+         * Requires JobManagerDescriptor::m_enableReactor. Returns a registration ID, or 0 on failure.
+         */
+        uint64_t RegisterFd(int fd, uint32_t events, JobDelegate delegate)
+        {
+            if (!m_reactor)
+            {
+                return 0;
+            }
+
+            const uint64_t registrationId = m_reactor->Register(fd, events, delegate);
+
+            // Ensure a worker is leading the reactor.
+            m_context.WakeOne();
+
+            return registrationId;
+        }
+
+        bool UnregisterFd(uint64_t registrationId)
+        {
+            return m_reactor ? m_reactor->Unregister(registrationId) : false;
+        }
+
+        /**
+         * Reads an entire file into buffer without blocking any worker. The returned state completes
+         * once the data has landed, and can be used as a dependency via AddDependant(), so downstream
+         * jobs become runnable immediately. buffer must outlive the read. On failure, buffer is cleared
+         * and *error (if provided) receives the errno value; otherwise *error receives 0.
+         * Cancelling the state cancels its dependants, but the read itself always runs to completion.
+         */
+        JobStatePtr ReadFileAsync(const char *path, std::vector<char> &buffer, int *error = nullptr)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_asyncFileReaderLock);
+
+                if (!m_asyncFileReader)
+                {
+                    m_asyncFileReader.reset(new AsyncFileReader(&m_context, m_desc.m_asyncIoThreadCount, m_desc.m_asyncIoQueueDepth));
+                }
+            }
+
+            return m_asyncFileReader->ReadFile(path, buffer, error);
+        }
+
+        /**
+         * Runs other jobs until the given job is done, rather than blocking. Safe to call from inside a
+         * job: the awaited job itself is run first if it's still queued, and helping is bounded by
+         * JobManagerDescriptor::m_maxHelpingDepth and m_maxHelpedJobCostMicroseconds.
+         */
+        void AssistUntilJobDone(JobStatePtr state)
+        {
+            JOBSYSTEM_ASSERT(state->m_ready.load(std::memory_order_acquire) || state->IsDone());
+            JOBSYSTEM_ASSERT(!m_workers.empty());
+
+            AssistUntil(*state);
+
+            state->RethrowException();
+        }
+
+        void AssistUntilDone()
+        {
+            JOBSYSTEM_ASSERT(!m_workers.empty());
+
+            // Steal and run jobs from workers until all queues are exhausted.
+
+            const affinity_t workerAffinity = kAffinityAllBits;
+
+            AssistScope assistScope(*this);
+
+            bool hasUnsatisfiedDependencies = true;
+            while (hasUnsatisfiedDependencies)
+            {
+                hasUnsatisfiedDependencies = false;
+
+                const uint64_t assistEpoch = m_context.m_assistEpoch.load(std::memory_order_seq_cst);
+
+                if (AssistOnce(workerAffinity, &hasUnsatisfiedDependencies))
+                {
+                    hasUnsatisfiedDependencies = true;
+                }
+                else if (hasUnsatisfiedDependencies)
+                {
+                    // Remaining jobs are waiting on others, which workers are presumably running.
+                    ParkAssist(nullptr, assistEpoch);
+                }
+            }
+
+            for (JobSystemWorker *worker : m_workers)
+            {
+                if (!worker->m_queue.empty())
+                {
+                    JOBSYSTEM_ASSERT(0);
+                }
+            }
+        }
+
+        void JoinWorkersAndShutdown(bool finishJobs = false)
+        {
+            if (m_watchdogTimer)
+            {
+                CancelTimer(m_watchdogTimer);
+                m_watchdogTimer = nullptr;
+            }
+
+            if (finishJobs)
+            {
+                AssistUntilDone();
+            }
+
+            // Let in-flight reads land first, so their dependants aren't left waiting on states that never complete.
+            {
+                std::lock_guard<std::mutex> lock(m_asyncFileReaderLock);
+                m_asyncFileReader.reset();
+            }
+
+            // Tear down each worker. Un-popped jobs may still reside in the queues at this point
+            // if finishJobs = false.
+            // Stop requests are issued to all workers under the signal lock and woken with a single
+            // broadcast, so every worker exits in parallel rather than one at a time.
+            {
+                std::lock_guard<std::mutex> signalLock(m_context.m_signalLock);
+
+                for (JobSystemWorker *worker : m_workers)
+                {
+                    JOBSYSTEM_ASSERT(worker);
+                    worker->RequestStop();
+                }
+            }
+
+            m_context.WakeAll();
+
+            // Don't destruct workers yet, in case someone's in the process of work-stealing.
+            // Joining in index order guarantees tree-spawned workers have been spawned by their
+            // parent (which has a lower index) before we attempt to join them.
+            for (JobSystemWorker *worker : m_workers)
+            {
+                worker->Join();
+            }
+
+            // Destruct all workers.
+            std::for_each(m_workers.begin(), m_workers.end(), [](JobSystemWorker *worker)
+                          { delete worker; });
+            m_workers.clear();
+            m_assistWorker = nullptr;
+
+            m_context.m_reactor = nullptr;
+            m_reactor.reset();
+
+            // With no workers left to service them, release timers still scheduled, which keep
+            // themselves and their delegates alive until they fire or are cancelled.
+            m_context.m_timers.Reset(std::chrono::microseconds(m_desc.m_timerResolutionMicroseconds));
+
+#ifdef JOBSYSTEM_ENABLE_PROFILING
+
+            delete[] m_timelines;
+            m_timelines = nullptr;
+
+#endif // JOBSYSTEM_ENABLE_PROFILING
+        }
+
+    private:
+        size_t m_nextRoundRobinWorkerIndex; // Index of the worker to receive the next requested job, round-robin style.
+
+        JobSystemContext m_context; // State shared with workers.
+
+        std::mutex m_asyncFileReaderLock;                  // Guards creation/destruction of m_asyncFileReader.
+        std::unique_ptr<AsyncFileReader> m_asyncFileReader; // Asynchronous file I/O, created on first use.
+
+        std::unique_ptr<JobReactor> m_reactor; // fd readiness reactor, if enabled.
+
+        std::atomic<unsigned int> m_jobsRun;      // Counter to track # of jobs run.
+        std::atomic<unsigned int> m_jobsAssisted; // Counter to track # of jobs run via external Assist*().
+        std::atomic<unsigned int> m_jobsStolen;   // Counter to track # of jobs stolen from another worker's queue.
+        std::atomic<affinity_t> m_usedMask;       // Mask with bits set according to the IDs of the jobs that have executed jobs.
+        std::atomic<affinity_t> m_awokenMask;     // Mask with bits set according to the IDs of the jobs that have been awoken at least once.
+
+    private:
+        JobManagerDescriptor m_desc; // Descriptor/configuration of the job manager.
+
+        bool m_hasPushedJob;            // For profiling - has a job been pushed yet?
+        TimePoint m_firstJobTime;       // For profiling - when was the first job pushed?
+        ProfilingTimeline *m_timelines; // For profiling - a ProfilingTimeline entry for each worker, plus an additional entry to represent the Assist thread.
+
+        std::vector<JobSystemWorker *> m_workers; // Storage for worker instances.
+
+        JobSystemWorker *m_assistWorker;       // Thread-less worker used by assisting threads. Last entry of m_workers.
+        std::atomic<bool> m_assistWorkerInUse; // Has an assisting thread taken the assist worker's identity?
+
+        TimerHandle m_watchdogTimer; // Periodic DumpStuckJobs() job, if the watchdog is enabled.
+
+        std::recursive_mutex m_deterministicLock;                       // Serializes deterministic steps across assisting threads. Recursive, as jobs step nested while waiting.
+        JobSchedule m_recordedSchedule;                                 // Jobs run so far in deterministic mode. Guarded by m_deterministicLock, as is the rest of the scheduler's state.
+        size_t m_replayPosition;                                        // Next entry of the descriptor's replay schedule to follow.
+        uint64_t m_deterministicRandom;                                 // Deterministic scheduler's generator state.
+        std::chrono::steady_clock::time_point m_deterministicStartTime; // Time that recorded start times are relative to.
+        uint64_t m_nestedStepNanoseconds;                               // Time spent in jobs run from within the job currently being stepped.
+
+        TimerHandle ScheduleTimer(size_t delayMicroseconds, size_t periodMicroseconds, JobDelegate delegate, char debugChar)
+        {
+            TimerHandle timer = m_context.m_timers.Schedule(delayMicroseconds, periodMicroseconds, delegate, debugChar);
+
+            // The leader may be parked with a longer (or no) timeout. Passing through the signal lock
+            // ensures it's either already waiting, and receives the wake, or hasn't yet computed its timeout.
+            {
+                std::lock_guard<std::mutex> signalLock(m_context.m_signalLock);
+            }
+            m_context.WakeLeader();
+
+            return timer;
+        }
+
+        bool AssistOnce(affinity_t workerAffinity, bool *hasUnsatisfiedDependencies = nullptr, const JobState *awaitedJob = nullptr, size_t maxCostHint = 0)
+        {
+            if (m_context.m_deterministic)
+            {
+                // Nothing can satisfy outstanding dependencies but us, so there's no point waiting on them.
+                if (hasUnsatisfiedDependencies)
+                {
+                    *hasUnsatisfiedDependencies = false;
+                }
+
+                return StepDeterministic();
+            }
+
+            // Our own workers (e.g. applying backpressure) pop through themselves, starting with their
+            // own queue; anyone else pops through the assist worker.
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            const bool onWorker = worker && worker->m_context == &m_context;
+            JobSystemWorker *popWorker = onWorker ? worker : m_assistWorker;
+
+            JobQueueEntry job;
+            bool foundUnsatisfiedDependencies = false;
+
+            const bool foundJob = popWorker->PopNextJob(job, foundUnsatisfiedDependencies, true, workerAffinity, awaitedJob, maxCostHint);
+
+            if (hasUnsatisfiedDependencies)
+            {
+                *hasUnsatisfiedDependencies = foundUnsatisfiedDependencies;
+            }
+
+            if (!foundJob)
+            {
+                return false;
+            }
+
+            RunAssistedJob(job);
+
+            return true;
+        }
+
+        void RunAssistedJob(JobQueueEntry &job)
+        {
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            const bool onWorker = worker && worker->m_context == &m_context;
+            const size_t timelineIndex = onWorker ? worker->m_workerIndex : m_assistWorker->m_workerIndex;
+
+            Observer(job, eJobEvent_JobStart, timelineIndex, job.m_state->m_jobId);
+            bool completed = true;
+            if (onWorker)
+            {
+                completed = worker->RunJob(job);
+            }
+            else
+            {
+                job.m_state->Run();
+            }
+            Observer(job, eJobEvent_JobDone, timelineIndex);
+
+            if (completed)
+            {
+                job.m_state->SetDone();
             }
 
-            return false;
+            Observer(job, eJobEvent_JobRunAssisted, 0);
+
+            m_context.WakeOne();
         }
 
-        bool PopNextJob(JobQueueEntry &job, bool &hasUnsatisfiedDependencies, bool useWorkStealing, affinity_t workerAffinity)
+        JobStatePtr AddLocalJob(JobDelegate delegate, char debugChar = 0)
         {
-            bool foundJob = false;
-
+            // Adds a ready job to the calling worker's own queue, where it's popped first and other
+            // workers can steal it; other threads queue it as usual. If the queues are full, the job
+            // is left unqueued for JoinForked() to run inline, rather than applying the overflow policy.
+            JobStatePtr state = std::make_shared<JobState>(&m_context);
+            state->m_delegate = std::move(delegate);
+            state->m_debugChar = debugChar;
+
+            if (m_workers.empty())
             {
-                std::lock_guard<std::mutex> queueLock(m_queueLock);
-                foundJob = PopJobFromQueue(m_queue, job, hasUnsatisfiedDependencies, workerAffinity);
+                return state;
             }
 
-            if (!foundJob && useWorkStealing)
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            const bool onWorker = worker && worker->m_context == &m_context;
+
+            if (!onWorker)
             {
-                for (size_t i = 0; foundJob == false && i < m_workerCount; ++i)
-                {
-                    JOBSYSTEM_ASSERT(m_allWorkers[i]);
-                    JobSystemWorker &worker = *m_allWorkers[i];
+                SpawnWorkerOnDemand();
+            }
 
-                    {
-                        std::lock_guard<std::mutex> queueLock(worker.m_queueLock);
-                        foundJob = PopJobFromQueue(worker.m_queue, job, hasUnsatisfiedDependencies, workerAffinity);
-                    }
-                }
+            bool crossedHighWatermark = false;
 
-                if (foundJob)
-                {
-                    NotifyEventObserver(job, eJobEvent_JobStolen, m_workerIndex);
-                }
+            const bool pushed = (onWorker && worker->PushJob(state, m_desc.m_workerQueueCapacity, &crossedHighWatermark)) ||
+                                TryPushJob(state, crossedHighWatermark);
+
+            if (crossedHighWatermark && m_desc.m_queueHighWatermarkCallback)
+            {
+                m_desc.m_queueHighWatermarkCallback(m_context.m_queuedJobCount.load(std::memory_order_relaxed));
             }
 
-            return foundJob;
-        }
+            // Only one worker is needed to take it, so unlike SetReady() we don't wake them all.
+            if (pushed && state->MarkReady())
+            {
+                if (m_context.m_pushToIdle)
+                {
+                    state->HandToIdleWorker();
+                }
 
-        void SetThreadName(const char *name)
-        {
-            (void)name;
+                m_context.WakeOne();
+            }
 
-            pthread_setname_np(pthread_self(), name);
+            return state;
         }
 
-        void WorkerThreadProc()
+        JobStatePtr BeginSpawningChildren()
         {
-            SetThreadName(m_desc.m_name.c_str());
-
-            cpu_set_t cpuset;
-            CPU_ZERO(&cpuset);
-            for (size_t i = 0; i < sizeof(m_desc.m_cpuAffinity) * 8; ++i)
+            // Returns the running job to add children to, or null when not called from a job on one
+            // of our workers. The first child also takes a count on behalf of the running job, released
+            // when it returns (see JobSystemWorker::RunJob()), so children finishing early can't complete it.
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            if (!worker || worker->m_context != &m_context || !worker->m_currentJob)
             {
-                if ((1 << i) & m_desc.m_cpuAffinity)
-                {
-                    CPU_SET(i, &cpuset);
-                }
+                return nullptr;
             }
 
-            const affinity_t workerAffinity = CalculateSafeWorkerAffinity(m_workerIndex, m_workerCount);
+            const JobStatePtr &parent = worker->m_currentJob->m_state;
 
-            while (true)
+            if (!parent->m_hasChildren)
             {
-                JobQueueEntry job;
-                {
-                    std::unique_lock<std::mutex> signalLock(s_signalLock);
+                parent->m_pendingChildren.fetch_add(1, std::memory_order_relaxed);
+                parent->m_hasChildren = true;
+            }
 
-                    bool hasUnsatisfiedDependencies;
+            return parent;
+        }
 
-                    while (!m_stop.load(std::memory_order_relaxed) &&
-                           !PopNextJob(job, hasUnsatisfiedDependencies, m_desc.m_enableWorkStealing, workerAffinity))
-                    {
-                        s_signalThreads.wait(signalLock);
-                        NotifyEventObserver(job, eJobEvent_WorkerAwoken, m_workerIndex);
-                    }
-                }
+        void SubmitChildJob(const JobStatePtr &parent, const JobStatePtr &child)
+        {
+            // The parent must be running, or be kept from completing by another child (e.g. the
+            // one calling us), for the count taken here to be meaningful.
+            parent->m_pendingChildren.fetch_add(1, std::memory_order_relaxed);
 
-                if (m_stop.load(std::memory_order_relaxed))
-                {
-                    m_hasShutDown.store(true, std::memory_order_release);
+            child->m_parent = parent;
+            child->InheritPriority(parent->m_priority.load(std::memory_order_relaxed));
 
-                    break;
-                }
+            SubmitJob(child);
+        }
 
-                s_activeWorkers.fetch_add(1, std::memory_order_acq_rel);
-                {
-                    NotifyEventObserver(job, eJobEvent_WorkerUsed, m_workerIndex);
+        JobStatePtr AddChildJob(const JobStatePtr &parent, JobDelegate delegate, char debugChar, const JobStatePtr &predecessor = nullptr)
+        {
+            JobStatePtr child = std::make_shared<JobState>(&m_context);
+            child->m_delegate = std::move(delegate);
+            child->m_debugChar = debugChar;
+            child->m_cancellationToken = parent->m_cancellationToken;
 
-                    NotifyEventObserver(job, eJobEvent_JobStart, m_workerIndex, job.m_state->m_jobId);
-                    job.m_delegate();
-                    NotifyEventObserver(job, eJobEvent_JobDone, m_workerIndex);
+            SubmitChildJob(parent, child);
 
-                    job.m_state->SetDone();
+            if (predecessor)
+            {
+                predecessor->AddDependant(child);
+            }
 
-                    NotifyEventObserver(job, eJobEvent_JobRun, m_workerIndex);
+            child->SetReady();
 
-                    s_signalThreads.notify_one();
-                }
-                s_activeWorkers.fetch_sub(1, std::memory_order_acq_rel);
-            }
+            return child;
         }
 
-        std::thread m_thread;            // Thread instance for worker.
-        std::atomic<bool> m_stop;        // Has a stop been requested?
-        std::atomic<bool> m_hasShutDown; // Has the worker completed shutting down?
+        void SpawnLoopIteration(const JobStatePtr &parent, std::function<bool()> condition, JobDelegate body, char debugChar)
+        {
+            // Each iteration is a body job and a check that depends on it, both children of the job
+            // running the loop, so completion doesn't nest deeper with the iteration count. The check
+            // runs once the body and its own children are done, and spawns the next iteration, unless
+            // the body threw.
+            const JobStatePtr bodyJob = AddChildJob(parent, body, debugChar);
+
+            AddChildJob(
+                parent,
+                [this, parent, bodyJob, condition, body, debugChar]()
+                {
+                    if (!bodyJob->GetException() && condition())
+                    {
+                        SpawnLoopIteration(parent, condition, body, debugChar);
+                    }
+                },
+                debugChar, bodyJob);
+        }
 
-        mutable std::mutex m_queueLock; // Mutex to guard worker queue.
-        JobQueue m_queue;               // Queue containing requested jobs.
+        void JoinForked(const JobStatePtr &state, bool rethrow)
+        {
+            // Runs the job inline if nobody has started it, otherwise helps until it's done. Jobs
+            // that were never queued are still claimed by their creator.
+            JobSystemWorker *owner = state->m_owner;
 
-        JobSystemWorker **m_allWorkers; // Pointer to array of all workers, for queue-sharing / work-stealing.
-        size_t m_workerCount;           // Number of total workers (size of m_allWorkers array).
-        size_t m_workerIndex;           // This worker's index within m_allWorkers.
+            if (owner ? owner->TryReclaimJob(state) : !state->IsDone())
+            {
+                JobSystemWorker *worker = JobSystemWorker::Current();
+                JobQueueEntry entry = {state, state->m_cancellationToken.get(), {}};
 
-        JobEventObserver m_eventObserver; // Observer of job-related events occurring on this worker.
-        JobWorkerDescriptor m_desc;       // Descriptor/configuration of this worker.
-    };
+                const bool completed = (worker && worker->m_context == &m_context) ? worker->RunJob(entry) : (state->Run(), true);
+                if (completed)
+                {
+                    state->SetDone();
+                }
+            }
 
-    /**
-     * Descriptor for configuring the job manager.
-     * - Contains descriptor for each worker
-     */
-    struct JobManagerDescriptor
-    {
-        std::vector<JobWorkerDescriptor> m_workers; // Configurations for all workers that should be spawned by JobManager.
-    };
+            AssistUntil(*state);
 
-    /**
-     * Manages job workers, and acts as the primary interface to the job queue.
-     */
-    class JobManager
-    {
-    private:
-        void Observer(const JobQueueEntry &job, EJobEvent event, uint64_t workerIndex, size_t jobId = 0)
-        {
-#ifdef JOBSYSTEM_ENABLE_PROFILING
-            switch (event)
-            {
-            case eJobEvent_JobRun:
+            if (rethrow)
             {
-                ++m_jobsRun;
+                state->RethrowException();
             }
-            break;
+        }
 
-            case eJobEvent_JobStolen:
+        void AssistUntil(JobState &state)
+        {
+            if (state.IsDone())
             {
-                ++m_jobsStolen;
+                return;
             }
-            break;
 
-            case eJobEvent_JobRunAssisted:
-            {
-                ++m_jobsAssisted;
-                ++m_jobsRun;
-            }
-            break;
+            AssistScope assistScope(*this);
 
-            case eJobEvent_WorkerAwoken:
+            // Helping runs jobs on top of the waiter's stack, so nested helping waits are bounded. Beyond
+            // the bound we only run the awaited job itself, or jobs it transitively depends on, if we
+            // get to them first, and otherwise park. Those may sit in our own queue, with nobody else
+            // to run them, and would run on this stack ahead of the awaited job anyway.
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            const bool onWorker = worker && worker->m_context == &m_context;
+            const bool mayHelp = !onWorker || m_desc.m_maxHelpingDepth == 0 || worker->m_helpingDepth < m_desc.m_maxHelpingDepth;
+
+            if (onWorker)
             {
-                m_awokenMask |= GetBit(workerIndex);
+                ++worker->m_helpingDepth;
             }
-            break;
 
-            case eJobEvent_WorkerUsed:
+            // Steal jobs from workers until the specified job is done, parking while there's nothing to run.
+            // Once the job is running elsewhere, we start with its children (see PopNextJob()).
+            while (!state.IsDone())
             {
-                m_usedMask |= GetBit(workerIndex);
+                JobQueueEntry job;
+                JobSystemWorker *owner = state.m_owner;
+                const uint64_t assistEpoch = m_context.m_assistEpoch.load(std::memory_order_seq_cst);
+
+                if (!m_context.m_deterministic && owner && !state.m_claimed.load(std::memory_order_acquire) && owner->PopJob(&state, job))
+                {
+                    RunAssistedJob(job);
+                }
+                else if (mayHelp ? !AssistOnce(kAffinityAllBits, nullptr, &state, m_desc.m_maxHelpedJobCostMicroseconds) : !RunUnmetPredecessor(state))
+                {
+                    ParkAssist(&state, assistEpoch);
+                }
             }
-            break;
 
-            case eJobEvent_JobStart:
+            if (onWorker)
             {
-                ProfilingTimeline &timeline = workerIndex < m_workers.size() ? m_timelines[workerIndex] : m_timelines[m_workers.size()];
-                ProfilingTimeline::TimelineEntry entry;
-                entry.jobId = jobId;
-                entry.start = ProfileClockNow();
-                entry.debugChar = job.m_state ? job.m_state->m_debugChar : 0;
-                timeline.m_entries.push_back(entry);
+                --worker->m_helpingDepth;
             }
-            break;
+        }
 
-            case eJobEvent_JobDone:
+        bool RunUnmetPredecessor(JobState &state)
+        {
+            // Runs one queued, runnable job that the given job transitively depends on, if any.
+            if (m_context.m_deterministic || state.AreDependenciesMet())
             {
-                ProfilingTimeline &timeline = workerIndex < m_workers.size() ? m_timelines[workerIndex] : m_timelines[m_workers.size()];
-                ProfilingTimeline::TimelineEntry &entry = timeline.m_entries.back();
-                entry.end = ProfileClockNow();
+                return false;
             }
-            break;
 
-            case eJobEvent_JobPopped:
+            std::vector<JobStatePtr> pending;
+            std::unordered_set<const JobState *> visited;
+            state.CollectPredecessors(pending);
+
+            while (!pending.empty())
             {
-                if (!m_hasPushedJob)
+                const JobStatePtr predecessor = std::move(pending.back());
+                pending.pop_back();
+
+                if (predecessor->IsDone() || !visited.insert(predecessor.get()).second)
                 {
-                    m_firstJobTime = ProfileClockNow();
-                    m_hasPushedJob = true;
+                    continue;
+                }
+
+                if (!predecessor->AreDependenciesMet())
+                {
+                    predecessor->CollectPredecessors(pending);
+                    continue;
+                }
+
+                JobQueueEntry job;
+                JobSystemWorker *owner = predecessor->m_owner;
+
+                if (owner && !predecessor->m_claimed.load(std::memory_order_acquire) && owner->PopJob(predecessor.get(), job))
+                {
+                    RunAssistedJob(job);
+                    return true;
                 }
             }
-            break;
-            }
-#endif // JOBSYSTEM_ENABLE_PROFILING
-        }
 
-    public:
-        JobManager()
-            : m_jobsRun(0), m_jobsStolen(0), m_usedMask(0), m_awokenMask(0), m_nextRoundRobinWorkerIndex(0), m_timelines(nullptr), m_firstJobTime()
-        {
+            return false;
         }
 
-        ~JobManager()
+        uint64_t NextDeterministicRandom()
         {
-            DumpProfilingResults();
+            // xorshift64, so schedules don't depend on the standard library's generators.
+            m_deterministicRandom ^= m_deterministicRandom << 13;
+            m_deterministicRandom ^= m_deterministicRandom >> 7;
+            m_deterministicRandom ^= m_deterministicRandom << 17;
 
-            JoinWorkersAndShutdown();
+            return m_deterministicRandom;
         }
 
-        bool Create(const JobManagerDescriptor &desc)
+        bool StepDeterministic()
         {
-            JoinWorkersAndShutdown();
+            // Runs one job, following the replay schedule if there is one, otherwise picking at random
+            // among everything runnable. Jobs run while assisting from within a job are recorded too,
+            // with their time excluded from the outer job's duration. Other assisting threads wait for
+            // the whole step, nested ones included, so jobs run one at a time in a reproducible order.
+            std::lock_guard<std::recursive_mutex> deterministicLock(m_deterministicLock);
 
-            m_desc = desc;
+            std::vector<JobState *> runnableJobs;
+            for (JobSystemWorker *worker : m_workers)
+            {
+                worker->CollectRunnableJobs(runnableJobs);
+            }
 
-            const size_t workerCount = desc.m_workers.size();
-            m_workers.reserve(workerCount);
+            if (runnableJobs.empty())
+            {
+                return false;
+            }
 
-#ifdef JOBSYSTEM_ENABLE_PROFILING
+            JobState *nextJob = nullptr;
 
-            m_timelines = new ProfilingTimeline[workerCount + 1];
-            m_hasPushedJob = false;
+            if (m_replayPosition < m_desc.m_replaySchedule.size())
+            {
+                const JobScheduleEntry &expected = m_desc.m_replaySchedule[m_replayPosition];
 
-#endif // JOBSYSTEM_ENABLE_PROFILING
+                for (JobState *job : runnableJobs)
+                {
+                    if (job->m_jobId == expected.jobId)
+                    {
+                        nextJob = job;
+                        ++m_replayPosition;
+                        break;
+                    }
+                }
 
-            const JobEventObserver observer = std::bind(
-                &JobManager::Observer, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
+                if (!nextJob)
+                {
+                    fprintf(stderr, "[jobsystem] replay diverged at step %zu: job #%zu '%c' isn't runnable\n", m_replayPosition, expected.jobId,
+                            expected.debugChar ? expected.debugChar : ' ');
+                    JOBSYSTEM_ASSERT(!"Replay diverged from the recorded schedule");
 
-            // Create workers. We don't spawn the threads yet.
-            for (size_t i = 0; i < workerCount; ++i)
-            {
-                const JobWorkerDescriptor &workerDesc = desc.m_workers[i];
+                    m_replayPosition = m_desc.m_replaySchedule.size();
+                }
+            }
 
-                JobSystemWorker *worker = new JobSystemWorker(workerDesc, observer);
-                m_workers.push_back(worker);
+            if (!nextJob)
+            {
+                nextJob = runnableJobs[NextDeterministicRandom() % runnableJobs.size()];
             }
 
-            // Start the workers (includes spawning threads). Each worker maintains
-            // understanding of what other workers exist, for work-stealing purposes.
-            for (size_t i = 0; i < workerCount; ++i)
+            JobQueueEntry job;
+            if (!nextJob->m_owner.load()->PopJob(nextJob, job))
             {
-                m_workers[i]->Start(i, &m_workers[0], workerCount);
+                return false;
             }
 
-            return !m_workers.empty();
-        }
+            // The entry is recorded when the job starts, so jobs it runs nested (e.g. while waiting on
+            // them) come after it, in the order replay will need them; it's completed once it returns.
+            const size_t entryIndex = m_recordedSchedule.size();
+            m_recordedSchedule.push_back(JobScheduleEntry());
+            m_recordedSchedule[entryIndex].jobId = job.m_state->m_jobId;
+            m_recordedSchedule[entryIndex].debugChar = job.m_state->m_debugChar;
 
-        JobStatePtr AddJob(JobDelegate delegate, char debugChar = 0)
-        {
-            JobStatePtr state = nullptr;
+            const uint64_t outerNestedNanoseconds = m_nestedStepNanoseconds;
+            m_nestedStepNanoseconds = 0;
 
-            // \todo - workers should maintain a tls pointer to themselves, so we can push
-            // directly into our own queue.
+            const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
 
-            if (!m_workers.empty())
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            const bool onWorker = worker && worker->m_context == &m_context;
+            const size_t timelineIndex = onWorker ? worker->m_workerIndex : m_assistWorker->m_workerIndex;
+
+            Observer(job, eJobEvent_JobStart, timelineIndex, job.m_state->m_jobId);
+            const bool completed = onWorker ? worker->RunJob(job) : (job.m_state->Run(), true);
+            Observer(job, eJobEvent_JobDone, timelineIndex);
+
+            const uint64_t elapsedNanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+
+            JobScheduleEntry &entry = m_recordedSchedule[entryIndex];
+            entry.startNanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(startTime - m_deterministicStartTime).count());
+            entry.durationNanoseconds = elapsedNanoseconds - std::min(elapsedNanoseconds, m_nestedStepNanoseconds);
+            m_nestedStepNanoseconds = outerNestedNanoseconds + elapsedNanoseconds;
+
+            if (completed)
             {
-                // Add round-robin style. Note that work-stealing helps load-balance,
-                // if it hasn't been disabled. If it has we may need to consider a
-                // smarter scheme here.
-                state = m_workers[m_nextRoundRobinWorkerIndex]->PushJob(delegate);
-                state->m_debugChar = debugChar;
+                job.m_state->SetDone();
 
-                m_nextRoundRobinWorkerIndex = (m_nextRoundRobinWorkerIndex + 1) % m_workers.size();
+                std::lock_guard<std::mutex> lock(job.m_state->m_doneMutex);
+                for (const JobStatePtr &dependant : job.m_state->m_dependants)
+                {
+                    entry.dependantIds.push_back(dependant->m_jobId);
+                }
             }
 
-            return state;
+            Observer(job, eJobEvent_JobRunAssisted, 0);
+
+            return true;
         }
 
-        void AssistUntilJobDone(JobStatePtr state)
+        void ParkAssist(JobState *awaitedState, uint64_t assistEpoch)
         {
-            JOBSYSTEM_ASSERT(state->m_ready.load(std::memory_order_acquire));
-
-            const affinity_t workerAffinity = kAffinityAllBits;
+            // Parks until new work or a job completion is announced (see JobSystemContext::WakeAssistants())
+            // after assistEpoch, read before we last looked for work, or the awaited job is done.
+            std::unique_lock<std::mutex> assistLock(m_context.m_assistLock);
 
-            // Steal jobs from workers until the specified job is done.
-            while (!state->IsDone())
-            {
-                JOBSYSTEM_ASSERT(!m_workers.empty());
+            m_context.m_parkedAssistCount.fetch_add(1, std::memory_order_seq_cst);
 
-                JobQueueEntry job;
-                bool hasUnsatisfiedDependencies;
+            m_context.m_assistSignal.wait(assistLock,
+                                          [this, awaitedState, assistEpoch]()
+                                          {
+                                              return m_context.m_assistEpoch.load(std::memory_order_seq_cst) != assistEpoch ||
+                                                     (awaitedState && awaitedState->IsDone());
+                                          });
 
-                if (m_workers[0]->PopNextJob(job, hasUnsatisfiedDependencies, true, workerAffinity))
-                {
-                    Observer(job, eJobEvent_JobStart, m_workers.size(), job.m_state->m_jobId);
-                    job.m_delegate();
-                    Observer(job, eJobEvent_JobDone, m_workers.size());
+            m_context.m_parkedAssistCount.fetch_sub(1, std::memory_order_acq_rel);
+        }
 
-                    job.m_state->SetDone();
+        /**
+         * Lets a thread from outside the pool assist as the assist worker for its lifetime, so jobs it
+         * adds go to that worker's queue, and jobs it runs may yield. Only one thread holds the
+         * identity at a time; concurrent assistants (and our own workers) keep their current one.
+         */
+        class AssistScope
+        {
+        public:
+            explicit AssistScope(JobManager &manager)
+                : m_manager(manager), m_previousWorker(JobSystemWorker::Current()), m_ownsIdentity(false)
+            {
+                const bool onWorker = m_previousWorker && m_previousWorker->m_context == &manager.m_context;
 
-                    Observer(job, eJobEvent_JobRunAssisted, 0);
+                if (!onWorker && !manager.m_assistWorkerInUse.exchange(true, std::memory_order_acquire))
+                {
+                    m_ownsIdentity = true;
+                    JobSystemWorker::Current() = manager.m_assistWorker;
+                }
+            }
 
-                    s_signalThreads.notify_one();
+            ~AssistScope()
+            {
+                if (m_ownsIdentity)
+                {
+                    JobSystemWorker::Current() = m_previousWorker;
+                    m_manager.m_assistWorkerInUse.store(false, std::memory_order_release);
                 }
             }
-        }
 
-        void AssistUntilDone()
+        private:
+            JobManager &m_manager;             // Manager being assisted.
+            JobSystemWorker *m_previousWorker; // Worker identity of the thread before assisting, restored afterwards.
+            bool m_ownsIdentity;               // Did we take the assist worker's identity?
+        };
+
+        bool TryPushJob(const JobStatePtr &state, bool &crossedHighWatermark, bool ignoreCapacity = false)
         {
-            JOBSYSTEM_ASSERT(!m_workers.empty());
+            // The total capacity is checked before pushing, so concurrent producers may briefly overshoot it.
+            if (!ignoreCapacity && m_desc.m_totalQueueCapacity > 0 &&
+                m_context.m_queuedJobCount.load(std::memory_order_seq_cst) >= m_desc.m_totalQueueCapacity)
+            {
+                return false;
+            }
 
-            // Steal and run jobs from workers until all queues are exhausted.
+            const size_t workerCapacity = ignoreCapacity ? 0 : m_desc.m_workerQueueCapacity;
 
-            const affinity_t workerAffinity = kAffinityAllBits;
+            const size_t workerCount = m_context.m_computeWorkerCount;
 
-            JobQueueEntry job;
-            bool foundBusyWorker = true;
+            if (m_desc.m_submissionPolicy == eSubmissionPolicy_PushToIdle)
+            {
+                // Jobs aren't runnable until readied, which is when they're handed to idle workers
+                // (see JobState::HandToIdleWorker()). Until then, a worker keeps the job local, where
+                // it's likely to run soonest if nobody is idle.
+                JobSystemWorker *worker = JobSystemWorker::Current();
+                if (worker && worker->m_context == &m_context && !worker->m_isSpare &&
+                    worker->PushJob(state, workerCapacity, &crossedHighWatermark))
+                {
+                    return true;
+                }
+            }
 
-            while (foundBusyWorker)
+            // Add round-robin style. Note that work-stealing helps load-balance,
+            // if it hasn't been disabled. If it has we may need to consider a
+            // smarter scheme here.
+            // Spawned workers with room are preferred; dormant (not yet spawned, or retired) workers
+            // are only used if none has room. Spares only steal.
+            for (int pass = 0; pass < 2; ++pass)
             {
-                foundBusyWorker = false;
+                size_t workerIndex = m_nextRoundRobinWorkerIndex % workerCount;
+                for (size_t attempt = 0; attempt < workerCount; ++attempt, workerIndex = (workerIndex + 1) % workerCount)
+                {
+                    JobSystemWorker *worker = m_workers[workerIndex];
+                    if (pass == 0 && !worker->IsSpawned())
+                    {
+                        continue;
+                    }
 
-                for (JobSystemWorker *worker : m_workers)
-                {
-                    if (worker->PopNextJob(job, foundBusyWorker, false, workerAffinity))
+                    if (!worker->PushJob(state, workerCapacity, &crossedHighWatermark))
                     {
-                        Observer(job, eJobEvent_JobStart, m_workers.size(), job.m_state->m_jobId);
-                        job.m_delegate();
-                        Observer(job, eJobEvent_JobDone, m_workers.size());
+                        continue;
+                    }
 
-                        job.m_state->SetDone();
+                    // The worker may have retired between selection and the push. Bring it back so
+                    // the job isn't stranded in a dormant queue.
+                    if (!worker->IsSpawned())
+                    {
+                        worker->Spawn();
+                    }
 
-                        Observer(job, eJobEvent_JobRunAssisted, 0);
+                    m_nextRoundRobinWorkerIndex = (workerIndex + 1) % workerCount;
 
-                        foundBusyWorker = true;
-                        s_signalThreads.notify_one();
-                        break;
-                    }
+                    return true;
                 }
             }
 
-            for (JobSystemWorker *worker : m_workers)
+            return false;
+        }
+
+        bool HasRunnableQueuedJob() const
+        {
+            for (const JobSystemWorker *worker : m_workers)
             {
-                if (!worker->m_queue.empty())
+                if (worker->HasRunnableJob())
                 {
-                    JOBSYSTEM_ASSERT(0);
+                    return true;
                 }
             }
+
+            return false;
         }
 
-        void JoinWorkersAndShutdown(bool finishJobs = false)
+        void HandleQueueOverflow(const JobStatePtr &state, bool &crossedHighWatermark)
         {
-            if (finishJobs)
+            EQueueOverflowPolicy policy = m_desc.m_queueOverflowPolicy;
+
+            // A worker blocking on its own queues could leave nobody to drain them.
+            JobSystemWorker *worker = JobSystemWorker::Current();
+            if (policy == eQueueOverflowPolicy_Block && worker && worker->m_context == &m_context)
             {
-                AssistUntilDone();
+                policy = eQueueOverflowPolicy_CallerRuns;
             }
 
-            // Tear down each worker. Un-popped jobs may still reside in the queues at this point
-            // if finishJobs = false.
-            // Don't destruct workers yet, in case someone's in the process of work-stealing.
-            for (size_t i = 0, n = m_workers.size(); i < n; ++i)
+            if (policy == eQueueOverflowPolicy_DropOldestBackground)
             {
-                JOBSYSTEM_ASSERT(m_workers[i]);
-                m_workers[i]->Shutdown();
+                const size_t workerCount = m_context.m_computeWorkerCount;
+                for (size_t i = 0; i < workerCount; ++i)
+                {
+                    if (m_workers[(m_nextRoundRobinWorkerIndex + i) % workerCount]->DropOldestBackgroundJob() &&
+                        TryPushJob(state, crossedHighWatermark))
+                    {
+                        return;
+                    }
+                }
             }
 
-            // Destruct all workers.
-            std::for_each(m_workers.begin(), m_workers.end(), [](JobSystemWorker *worker)
-                          { delete worker; });
-            m_workers.clear();
+            if (policy == eQueueOverflowPolicy_Reject || policy == eQueueOverflowPolicy_DropOldestBackground)
+            {
+                state->m_delegate = nullptr;
+                state->SetRejected();
 
-#ifdef JOBSYSTEM_ENABLE_PROFILING
+                return;
+            }
 
-            delete[] m_timelines;
-            m_timelines = nullptr;
+            // Registering as blocked before re-trying the push guarantees any dequeue that frees space
+            // afterwards bumps the epoch, so the wait below can't miss it.
+            m_context.m_blockedProducerCount.fetch_add(1, std::memory_order_seq_cst);
 
-#endif // JOBSYSTEM_ENABLE_PROFILING
-        }
+            while (true)
+            {
+                const size_t epoch = m_context.m_dequeueEpoch.load(std::memory_order_relaxed);
 
-    private:
-        size_t m_nextRoundRobinWorkerIndex; // Index of the worker to receive the next requested job, round-robin style.
+                if (TryPushJob(state, crossedHighWatermark))
+                {
+                    break;
+                }
 
-        std::atomic<unsigned int> m_jobsRun;      // Counter to track # of jobs run.
-        std::atomic<unsigned int> m_jobsAssisted; // Counter to track # of jobs run via external Assist*().
-        std::atomic<unsigned int> m_jobsStolen;   // Counter to track # of jobs stolen from another worker's queue.
-        std::atomic<affinity_t> m_usedMask;       // Mask with bits set according to the IDs of the jobs that have executed jobs.
-        std::atomic<affinity_t> m_awokenMask;     // Mask with bits set according to the IDs of the jobs that have been awoken at least once.
+                if (policy == eQueueOverflowPolicy_CallerRuns && AssistOnce(kAffinityAllBits))
+                {
+                    continue;
+                }
 
-    private:
-        JobManagerDescriptor m_desc; // Descriptor/configuration of the job manager.
+                // Space only frees up as queued jobs are popped. If none can be, e.g. because they're
+                // all still waiting on the producer to ready them, waiting would never end, so the
+                // job is queued over capacity instead.
+                if (!HasRunnableQueuedJob())
+                {
+                    TryPushJob(state, crossedHighWatermark, true);
+                    break;
+                }
 
-        bool m_hasPushedJob;            // For profiling - has a job been pushed yet?
-        TimePoint m_firstJobTime;       // For profiling - when was the first job pushed?
-        ProfilingTimeline *m_timelines; // For profiling - a ProfilingTimeline entry for each worker, plus an additional entry to represent the Assist thread.
+                std::unique_lock<std::mutex> lock(m_context.m_queueSpaceLock);
+                m_context.m_queueSpaceSignal.wait(lock,
+                                                  [this, epoch]()
+                                                  {
+                                                      return m_context.m_dequeueEpoch.load(std::memory_order_relaxed) != epoch;
+                                                  });
+            }
 
-        std::vector<JobSystemWorker *> m_workers; // Storage for worker instances.
+            m_context.m_blockedProducerCount.fetch_sub(1, std::memory_order_seq_cst);
+        }
 
         void DumpProfilingResults()
         {
@@ -804,11 +4849,11 @@ namespace jobsystem
             const char *busySymbols = "abcdefghijklmn";
             const size_t busySymbolCount = strlen(busySymbols);
 
-            for (size_t workerIndex = 0; workerIndex < workerCount + 1; ++workerIndex)
+            for (size_t workerIndex = 0; workerIndex < workerCount; ++workerIndex)
             {
                 ProfilingTimeline &timeline = m_timelines[workerIndex];
 
-                const char *name = (workerIndex < workerCount) ? m_workers[workerIndex]->m_desc.m_name.c_str() : "[Assist]";
+                const char *name = m_workers[workerIndex]->m_desc.m_name.c_str();
 
                 const size_t bufferSize = 200;
                 char buffer[bufferSize];
@@ -863,6 +4908,39 @@ namespace jobsystem
         }
     };
 
+    /**
+     * Marks the calling job as about to block (e.g. on a syscall) for the lifetime of the scope.
+     * While any worker is blocked, the manager activates a spare worker in its place so compute
+     * capacity stays constant. Requires JobManagerDescriptor::m_spareWorkerCount > 0 to have effect.
+     *
+     * e.g.
+     *
+     * jobManager.AddJob([&]() {
+     *     jobsystem::BlockingScope blocking(jobManager);
+     *     read(fd, buffer, size);
+     * });
+     */
+    class BlockingScope
+    {
+    public:
+        explicit BlockingScope(JobManager &manager)
+            : m_manager(manager)
+        {
+            m_manager.BeginBlocking();
+        }
+
+        ~BlockingScope()
+        {
+            m_manager.EndBlocking();
+        }
+
+    private:
+        BlockingScope(const BlockingScope &) = delete;
+        BlockingScope &operator=(const BlockingScope &) = delete;
+
+        JobManager &m_manager; // Manager owning the blocked worker.
+    };
+
     /**
      * Helper for building complex job/dependency chains logically.
      *
@@ -896,14 +4974,46 @@ namespace jobsystem
     class JobChainBuilder
     {
     public:
+        /**
+         * The branches of an If() node, submitted when it runs.
+         */
+        struct Conditional
+        {
+            Conditional() : inElse(false) {}
+
+            std::function<bool()> condition;
+            std::vector<JobStatePtr> branches[2]; // Jobs of the If() and Else() branches, created unqueued.
+            bool inElse;                          // Is the builder adding to the Else() branch?
+        };
+
         struct Node
         {
-            Node() : isGroup(false), groupDependency(nullptr) {}
+            Node() : groupDependency(nullptr), isGroup(false), cost(0), debugChar(0) {}
             ~Node() {}
 
             Node *groupDependency;
             JobStatePtr job;
             bool isGroup;
+            std::shared_ptr<Conditional> conditional; // Set for If() nodes.
+            size_t cost;                              // Work attributed to the node by Analyze(): 1 for Do() and If() jobs, 0 for groups and the join.
+            char debugChar;                           // Debug character, for ExportDot().
+        };
+
+        typedef std::pair<size_t, size_t> Edge; // Dependency edge, as (predecessor, dependant) node indices.
+
+        /**
+         * Results of Analyze(). Each Do() job counts as one unit of work.
+         */
+        struct Analysis
+        {
+            size_t jobCount;    // Jobs in the graph, including groups and the join.
+            size_t edgeCount;   // Dependency edges.
+            size_t work;        // Total work.
+            size_t span;        // Work along the critical (longest) path, i.e. the minimum run time with unlimited workers.
+            double parallelism; // work / span: the most workers the graph can keep busy on average.
+
+            std::vector<size_t> criticalPath; // Node indices along the critical path, in execution order.
+            std::vector<Edge> redundantEdges; // Edges already implied by another path. They never add parallelism, and often indicate accidental serialization.
         };
 
         Node *AllocNode()
@@ -935,18 +5045,24 @@ namespace jobsystem
             m_dependency = nullptr;
             m_nextNodeIndex = 0;
             m_failed = false;
+
+            m_cancellationToken = std::make_shared<CancellationToken>();
+            m_edges.clear();
         }
 
-        JobChainBuilder &Together(char debugChar = 0)
+        /**
+         * Opens a group of jobs that run together. A group's priority is inherited by its members, and
+         * by anything they wait on, once the graph is submitted via Go().
+         */
+        JobChainBuilder &Together(char debugChar = 0, EJobPriority priority = eJobPriority_Normal)
         {
             if (Node *item = AllocNode())
             {
                 item->isGroup = true;
                 item->groupDependency = m_dependency;
 
-                item->job = mgr.AddJob([]() {}, debugChar);
-
-                m_allJobs.push_back(item->job);
+                item->job = CreateNodeJob([]() {}, debugChar, priority);
+                item->debugChar = debugChar;
 
                 m_last = item;
                 m_dependency = nullptr;
@@ -961,29 +5077,29 @@ namespace jobsystem
             return *this;
         }
 
-        JobChainBuilder &Do(JobDelegate delegate, char debugChar = 0)
+        JobChainBuilder &Do(JobDelegate delegate, char debugChar = 0, EJobPriority priority = eJobPriority_Normal)
         {
             Node *owner = m_stack.back();
 
             if (Node *item = AllocNode())
             {
-                item->job = mgr.AddJob(delegate, debugChar);
-
-                m_allJobs.push_back(item->job);
+                item->job = CreateNodeJob(delegate, debugChar, priority);
+                item->cost = 1;
+                item->debugChar = debugChar;
 
                 if (m_dependency)
                 {
-                    m_dependency->job->AddDependant(item->job);
+                    AddEdge(m_dependency, item);
                     m_dependency = nullptr;
                 }
 
                 if (owner && owner->isGroup)
                 {
-                    item->job->AddDependant(owner->job);
+                    AddEdge(item, owner);
 
                     if (owner->groupDependency)
                     {
-                        owner->groupDependency->job->AddDependant(item->job);
+                        AddEdge(owner->groupDependency, item);
                     }
                 }
 
@@ -997,6 +5113,99 @@ namespace jobsystem
             return *this;
         }
 
+        /**
+         * Adds a node that evaluates condition at run time, then runs the nodes built up to Else() if
+         * it returns true, or those from Else() to EndIf() otherwise:
+         *
+         *   builder.If(nothingMoved).Do(reuseContacts).Else().Do(broadphase).Then().Do(narrowphase).EndIf();
+         *
+         * Branch jobs are created unqueued, and only the chosen branch is queued, as children of the
+         * node (see JobManager::SpawnChildren()), so the node's successors wait for it. The branch not
+         * taken is never queued or readied; skipping it costs nothing, however large it is.
+         */
+        JobChainBuilder &If(std::function<bool()> condition, char debugChar = 0, EJobPriority priority = eJobPriority_Normal)
+        {
+            std::shared_ptr<Conditional> conditional = std::make_shared<Conditional>();
+            conditional->condition = std::move(condition);
+
+            JobManager &manager = mgr;
+            const size_t nodeIndex = m_nextNodeIndex;
+
+            Do(
+                [&manager, conditional]()
+                {
+                    manager.SpawnChildren(conditional->branches[conditional->condition() ? 0 : 1]);
+                },
+                debugChar, priority);
+
+            // Without a node (the pool is exhausted) the build has already failed, and Else() and
+            // EndIf() fail it again.
+            if (m_nextNodeIndex > nodeIndex)
+            {
+                Node *item = &m_nodePool[nodeIndex];
+                item->conditional = conditional;
+                m_stack.push_back(item);
+
+                m_last = nullptr;
+                m_dependency = nullptr;
+            }
+
+            return *this;
+        }
+
+        JobChainBuilder &Else()
+        {
+            Node *owner = m_stack.back();
+            if (!owner->conditional || owner->conditional->inElse)
+            {
+                Fail();
+                return *this;
+            }
+
+            owner->conditional->inElse = true;
+
+            m_last = nullptr;
+            m_dependency = nullptr;
+
+            return *this;
+        }
+
+        JobChainBuilder &EndIf()
+        {
+            Node *owner = m_stack.back();
+            if (!owner->conditional)
+            {
+                Fail();
+                return *this;
+            }
+
+            // The If() node stands for the whole conditional to whatever follows.
+            m_stack.pop_back();
+
+            m_last = owner;
+            m_dependency = nullptr;
+
+            return *this;
+        }
+
+        /**
+         * Adds a node that runs body for as long as condition holds, e.g. solver iterations until
+         * convergence. Each iteration runs as a job once the previous one, including any children it
+         * spawned, has completed (see JobManager::SpawnLoop()). The node's successors wait for the
+         * loop to end.
+         */
+        JobChainBuilder &While(std::function<bool()> condition, JobDelegate body, char debugChar = 0, EJobPriority priority = eJobPriority_Normal)
+        {
+            JobManager &manager = mgr;
+
+            return Do(
+                [&manager, condition, body, debugChar]()
+                {
+                    manager.SpawnLoop(condition, body, debugChar);
+                },
+                debugChar, priority);
+        }
+
         JobChainBuilder &Then()
         {
             m_dependency = m_last;
@@ -1028,6 +5237,16 @@ namespace jobsystem
 
         JobChainBuilder &Go()
         {
+            // An If() without its EndIf() would take the join into its branch.
+            for (const Node *node : m_stack)
+            {
+                if (node->conditional)
+                {
+                    Fail();
+                    return *this;
+                }
+            }
+
             if (m_allJobs.empty())
             {
                 return *this;
@@ -1035,7 +5254,15 @@ namespace jobsystem
 
             Then();
             Do([]() {}, 'J');
+
+            // Without a node for the join, the build has failed and its jobs are cancelled.
+            if (m_failed)
+            {
+                return *this;
+            }
+
             m_joinJob = m_allJobs.back();
+            m_last->cost = 0;
 
             for (JobStatePtr &job : m_allJobs)
             {
@@ -1047,9 +5274,13 @@ namespace jobsystem
 
         void Fail()
         {
+            // Cancellation propagates to dependants, so cancelling the roots abandons the whole graph.
             for (JobStatePtr &job : m_allJobs)
             {
-                job->Cancel();
+                if (!job->IsDone() && !job->HasDependencies())
+                {
+                    job->Cancel();
+                }
             }
 
             m_allJobs.clear();
@@ -1061,6 +5292,208 @@ namespace jobsystem
             return m_failed;
         }
 
+        /**
+         * Cancels the whole chain, including jobs already submitted via Go(). Jobs that haven't
+         * started complete without running, so WaitForAll() returns promptly.
+         */
+        void Cancel()
+        {
+            mgr.Cancel(m_cancellationToken);
+        }
+
+        /**
+         * Computes work, span, parallelism and redundant edges of the graph built so far, without
+         * running it, so serialization bottlenecks can be spotted up front.
+         */
+        Analysis Analyze() const
+        {
+            Analysis analysis;
+            analysis.jobCount = 0;
+            analysis.edgeCount = m_edges.size();
+            analysis.work = 0;
+            analysis.span = 0;
+            analysis.parallelism = 0.0;
+
+            const size_t nodeCount = m_nextNodeIndex;
+
+            std::vector<std::vector<size_t>> successors(nodeCount);
+            std::vector<size_t> predecessorCounts(nodeCount, 0);
+            for (const Edge &edge : m_edges)
+            {
+                successors[edge.first].push_back(edge.second);
+                ++predecessorCounts[edge.second];
+            }
+
+            // Topological order (Kahn), over nodes that have jobs.
+            std::vector<size_t> order;
+            order.reserve(nodeCount);
+            for (size_t i = 0; i < nodeCount; ++i)
+            {
+                if (m_nodePool[i].job)
+                {
+                    ++analysis.jobCount;
+                    analysis.work += m_nodePool[i].cost;
+
+                    if (predecessorCounts[i] == 0)
+                    {
+                        order.push_back(i);
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                for (size_t successor : successors[order[i]])
+                {
+                    if (--predecessorCounts[successor] == 0)
+                    {
+                        order.push_back(successor);
+                    }
+                }
+            }
+
+            // Longest path ending at each node, tracking predecessors to recover the critical path.
+            const size_t kNone = static_cast<size_t>(~0);
+            std::vector<size_t> finish(nodeCount, 0);
+            std::vector<size_t> criticalPredecessor(nodeCount, kNone);
+            size_t criticalEnd = kNone;
+
+            for (size_t node : order)
+            {
+                finish[node] += m_nodePool[node].cost;
+
+                if (criticalEnd == kNone || finish[node] > finish[criticalEnd])
+                {
+                    criticalEnd = node;
+                }
+
+                for (size_t successor : successors[node])
+                {
+                    if (criticalPredecessor[successor] == kNone || finish[node] > finish[successor])
+                    {
+                        finish[successor] = finish[node];
+                        criticalPredecessor[successor] = node;
+                    }
+                }
+            }
+
+            for (size_t node = criticalEnd; node != kNone; node = criticalPredecessor[node])
+            {
+                analysis.criticalPath.insert(analysis.criticalPath.begin(), node);
+            }
+
+            analysis.span = (criticalEnd != kNone) ? finish[criticalEnd] : 0;
+            analysis.parallelism = analysis.span ? double(analysis.work) / double(analysis.span) : 0.0;
+
+            // Reachability bitsets, in reverse topological order. An edge u -> v is redundant if v is
+            // also reachable through another of u's successors.
+            const size_t wordCount = (nodeCount + 63) / 64;
+            std::vector<uint64_t> reachable(nodeCount * wordCount, 0);
+
+            for (auto nodeIter = order.rbegin(); nodeIter != order.rend(); ++nodeIter)
+            {
+                uint64_t *nodeReachable = &reachable[*nodeIter * wordCount];
+
+                for (size_t successor : successors[*nodeIter])
+                {
+                    const uint64_t *successorReachable = &reachable[successor * wordCount];
+                    for (size_t word = 0; word < wordCount; ++word)
+                    {
+                        nodeReachable[word] |= successorReachable[word];
+                    }
+                }
+
+                for (size_t successor : successors[*nodeIter])
+                {
+                    for (size_t other : successors[*nodeIter])
+                    {
+                        if (other != successor && (reachable[other * wordCount + successor / 64] & GetBit(successor % 64)))
+                        {
+                            analysis.redundantEdges.push_back(Edge(*nodeIter, successor));
+                            break;
+                        }
+                    }
+
+                    nodeReachable[successor / 64] |= GetBit(successor % 64);
+                }
+            }
+
+            return analysis;
+        }
+
+        /**
+         * Exports the graph built so far in Graphviz DOT format. Nodes are labelled with their debug
+         * characters; groups are drawn as boxes, the critical path in bold and redundant edges dashed red.
+         */
+        std::string ExportDot() const
+        {
+            const Analysis analysis = Analyze();
+
+            const size_t kNone = static_cast<size_t>(~0);
+            std::vector<bool> critical(m_nextNodeIndex, false);
+            std::vector<size_t> criticalSuccessor(m_nextNodeIndex, kNone);
+            for (size_t i = 0; i < analysis.criticalPath.size(); ++i)
+            {
+                critical[analysis.criticalPath[i]] = true;
+                if (i + 1 < analysis.criticalPath.size())
+                {
+                    criticalSuccessor[analysis.criticalPath[i]] = analysis.criticalPath[i + 1];
+                }
+            }
+
+            std::string dot = "digraph JobChain\n{\n    rankdir=LR;\n";
+            char line[128];
+
+            for (size_t i = 0; i < m_nextNodeIndex; ++i)
+            {
+                const Node &node = m_nodePool[i];
+                if (!node.job)
+                {
+                    continue;
+                }
+
+                char label[8];
+                if (node.debugChar == '"' || node.debugChar == '\\')
+                {
+                    snprintf(label, sizeof(label), "\\%c", node.debugChar);
+                }
+                else if (node.debugChar > ' ' && node.debugChar < 127)
+                {
+                    snprintf(label, sizeof(label), "%c", node.debugChar);
+                }
+                else
+                {
+                    snprintf(label, sizeof(label), "#%zu", i % 100000);
+                }
+
+                snprintf(line, sizeof(line), "    n%zu [label=\"%s\"%s%s];\n", i, label,
+                         node.isGroup ? ", shape=box" : "", critical[i] ? ", penwidth=3" : "");
+                dot += line;
+            }
+
+            for (const Edge &edge : m_edges)
+            {
+                const bool redundant = analysis.redundantEdges.end() != std::find(analysis.redundantEdges.begin(), analysis.redundantEdges.end(), edge);
+                const bool onCriticalPath = (criticalSuccessor[edge.first] == edge.second);
+
+                snprintf(line, sizeof(line), "    n%zu -> n%zu%s;\n", edge.first, edge.second,
+                         redundant ? " [color=red, style=dashed]" : onCriticalPath ? " [penwidth=3]" : "");
+                dot += line;
+            }
+
+            dot += "}\n";
+
+            return dot;
+        }
+
+        /**
+         * The token shared by every job in the chain, which running jobs can poll.
+         */
+        const CancellationTokenPtr &GetCancellationToken() const
+        {
+            return m_cancellationToken;
+        }
+
         void WaitForAll()
         {
             if (m_joinJob)
@@ -1071,7 +5504,10 @@ namespace jobsystem
 
         void AssistAndWaitForAll()
         {
-            mgr.AssistUntilJobDone(m_joinJob);
+            if (m_joinJob)
+            {
+                mgr.AssistUntilJobDone(m_joinJob);
+            }
         }
 
         JobManager &mgr; // Job manager to submit jobs to.
@@ -1087,6 +5523,37 @@ namespace jobsystem
 
         JobStatePtr m_joinJob; // Final join job that callers can wait on to complete the batch.
 
+        CancellationTokenPtr m_cancellationToken; // Token shared by all jobs in the chain.
+
+        std::vector<Edge> m_edges; // Dependency edges added by the builder, for Analyze() / ExportDot().
+
+        JobStatePtr CreateNodeJob(JobDelegate delegate, char debugChar, EJobPriority priority)
+        {
+            // Jobs inside an If() branch are held back for the If() node to submit; the rest are
+            // queued now and readied by Go().
+            for (auto nodeIter = m_stack.rbegin(); nodeIter != m_stack.rend(); ++nodeIter)
+            {
+                if (Conditional *conditional = (*nodeIter)->conditional.get())
+                {
+                    JobStatePtr job = mgr.CreateJob(delegate, debugChar, priority, m_cancellationToken);
+                    conditional->branches[conditional->inElse ? 1 : 0].push_back(job);
+
+                    return job;
+                }
+            }
+
+            JobStatePtr job = mgr.AddJob(delegate, debugChar, priority, m_cancellationToken);
+            m_allJobs.push_back(job);
+
+            return job;
+        }
+
+        void AddEdge(Node *from, Node *to)
+        {
+            from->job->AddDependant(to->job);
+            m_edges.push_back(Edge(from - m_nodePool, to - m_nodePool));
+        }
+
         bool m_failed; // Did an error occur during creation of the DAG?
     };
 
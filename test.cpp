@@ -5,6 +5,7 @@
 
 // jobsystem settings
 // #define JOBSYSTEM_ENABLE_PROFILING                // Enables worker/job profiling, and an ascii profile dump on shutdown.
+// #define JOBSYSTEM_ENABLE_VALIDATION               // Detects dependency cycles, late edges and orphaned jobs, and enables the stuck-job watchdog. Cycle checks search the graph on every AddDependant(), O(E*V) to build a graph.
 #define JOBSYSTEM_ASSERT(...) assert(__VA_ARGS__) // Directs internal system asserts to app-specific assert mechanism.
 
 // jobsystem include
@@ -108,5 +109,448 @@ int main()
 
     // dex::ICaptureStop();
 
+    // Regression: with bounded queues, jobs added before being readied mustn't block their producer
+    // forever, since nothing can pop them until it readies them.
+    {
+        jobsystem::JobManagerDescriptor boundedDesc;
+        boundedDesc.m_workers.emplace_back("Worker");
+        boundedDesc.m_workers.emplace_back("Worker");
+        boundedDesc.m_totalQueueCapacity = 4;
+        boundedDesc.m_queueOverflowPolicy = jobsystem::eQueueOverflowPolicy_Block;
+
+        jobsystem::JobManager boundedManager;
+        if (!boundedManager.Create(boundedDesc))
+        {
+            return 1;
+        }
+
+        std::atomic<int> boundedRuns(0);
+        std::vector<jobsystem::JobStatePtr> boundedJobs;
+        for (size_t i = 0; i < 8; ++i)
+        {
+            boundedJobs.push_back(boundedManager.AddJob([&]()
+                                                        { ++boundedRuns; }));
+        }
+
+        for (jobsystem::JobStatePtr &job : boundedJobs)
+        {
+            job->SetReady();
+        }
+
+        for (jobsystem::JobStatePtr &job : boundedJobs)
+        {
+            boundedManager.AssistUntilJobDone(job);
+        }
+
+        if (boundedRuns != 8)
+        {
+            return 1;
+        }
+    }
+
+    // Conditional nodes: only the branch chosen at run time is queued and run, and what follows the
+    // conditional waits for it.
+    {
+        std::atomic<int> takenRuns(0), skippedRuns(0);
+        int runsSeenAfter = -1;
+
+        auto taken = [&]()
+        {
+            ++takenRuns;
+        };
+
+        auto skipped = [&]()
+        {
+            ++skippedRuns;
+        };
+
+        jobsystem::JobChainBuilder<64> conditionalBuilder(jobManager);
+
+        conditionalBuilder
+            .If([]()
+                { return false; },
+                '?')
+            .Do(skipped, 's')
+            .Then()
+            .Do(skipped, 's')
+            .Else()
+            .Do(taken, 't')
+            .Then()
+            .Together()
+            .Do(taken, 't')
+            .Do(taken, 't')
+            .Close()
+            .EndIf()
+            .Then()
+            .Do([&]()
+                { runsSeenAfter = takenRuns; },
+                'Z');
+
+        conditionalBuilder
+            .Go()
+            .AssistAndWaitForAll();
+
+        if (conditionalBuilder.Failed() || skippedRuns != 0 || takenRuns != 3 || runsSeenAfter != 3)
+        {
+            return 1;
+        }
+    }
+
+    // Graph analysis: a diamond a -> (b, c) -> d, grouped so that a's edge to the outer group is
+    // implied by the path through the diamond.
+    {
+        jobsystem::JobChainBuilder<16> analysisBuilder(jobManager);
+
+        analysisBuilder
+            .Together('g')
+            .Do([]() {}, 'a')
+            .Then()
+            .Together('h')
+            .Do([]() {}, 'b')
+            .Do([]() {}, 'c')
+            .Close()
+            .Then()
+            .Do([]() {}, 'd')
+            .Close();
+
+        analysisBuilder
+            .Go()
+            .AssistAndWaitForAll();
+
+        const jobsystem::JobChainBuilder<16>::Analysis analysis = analysisBuilder.Analyze();
+        const jobsystem::JobChainBuilder<16>::Edge redundantEdge(2, 1); // a -> g
+
+        if (analysisBuilder.Failed() || analysis.work != 4 || analysis.span != 3 || analysis.parallelism < 1.33 || analysis.parallelism > 1.34 ||
+            analysis.redundantEdges.size() != 1 || analysis.redundantEdges[0] != redundantEdge ||
+            analysisBuilder.ExportDot().find("n2 -> n1 [color=red, style=dashed];") == std::string::npos)
+        {
+            return 1;
+        }
+
+        // Running out of nodes for the join fails the build, rather than submitting it.
+        jobsystem::JobChainBuilder<2> exhaustedBuilder(jobManager);
+        exhaustedBuilder.Do([]() {}, 'a').Go().AssistAndWaitForAll();
+
+        if (!exhaustedBuilder.Failed())
+        {
+            return 1;
+        }
+    }
+
+    // Priority inheritance: a Background job that a High job depends on moves ahead of the other
+    // Background work queued with it.
+    {
+        jobsystem::JobManagerDescriptor priorityDesc;
+        priorityDesc.m_workers.emplace_back("Worker");
+
+        jobsystem::JobManager priorityManager;
+        if (!priorityManager.Create(priorityDesc))
+        {
+            return 1;
+        }
+
+        // Occupy the only worker while the queue is built up behind it.
+        std::atomic<bool> blockerStarted(false), releaseBlocker(false);
+        jobsystem::JobStatePtr blocker = priorityManager.AddJob([&]()
+                                                                {
+                                                                    blockerStarted = true;
+                                                                    while (!releaseBlocker)
+                                                                        std::this_thread::yield(); });
+        blocker->SetReady();
+
+        while (!blockerStarted)
+        {
+            std::this_thread::yield();
+        }
+
+        std::mutex orderLock;
+        std::string order;
+        auto record = [&](char c)
+        {
+            std::lock_guard<std::mutex> lock(orderLock);
+            order += c;
+        };
+
+        // Queues pop newest first, so the predecessor is queued first, to end up behind the rest.
+        std::vector<jobsystem::JobStatePtr> backgroundJobs;
+        backgroundJobs.push_back(priorityManager.AddJob([&]()
+                                                        { record('p'); },
+                                                        'p', jobsystem::eJobPriority_Background));
+
+        for (size_t i = 0; i < 3; ++i)
+        {
+            backgroundJobs.push_back(priorityManager.AddJob([&]()
+                                                            { record('x'); },
+                                                            'x', jobsystem::eJobPriority_Background));
+        }
+
+        for (jobsystem::JobStatePtr &job : backgroundJobs)
+        {
+            job->SetReady();
+        }
+
+        jobsystem::JobStatePtr urgent = priorityManager.AddJob([&]()
+                                                               { record('h'); },
+                                                               'h', jobsystem::eJobPriority_High);
+        backgroundJobs.front()->AddDependant(urgent);
+        urgent->SetReady();
+
+        releaseBlocker = true;
+
+        // Wait without assisting, so only the worker pops, in queue order.
+        while (!urgent->IsDone())
+        {
+            std::this_thread::yield();
+        }
+
+        for (jobsystem::JobStatePtr &job : backgroundJobs)
+        {
+            priorityManager.AssistUntilJobDone(job);
+        }
+
+        priorityManager.AssistUntilJobDone(blocker);
+
+        if (order.size() != 5 || order[0] != 'p' || order[1] != 'h')
+        {
+            return 1;
+        }
+    }
+
+    // Spawned children: a node completes, releasing its Then() successor, only once every child it
+    // spawned at run time has.
+    {
+        const int kChildCount = 64;
+        std::atomic<int> childRuns(0);
+        int runsSeenAfter = -1;
+
+        jobsystem::JobChainBuilder<16> spawningBuilder(jobManager);
+
+        spawningBuilder
+            .Do([&]()
+                {
+                    for (int i = 0; i < kChildCount; ++i)
+                    {
+                        jobManager.SpawnChild([&]()
+                                              {
+                                                  for (size_t j = 0; j < kItersPerJob; ++j)
+                                                      floats[48] *= 5.f;
+                                                  ++childRuns; });
+                    } },
+                'p')
+            .Then()
+            .Do([&]()
+                { runsSeenAfter = childRuns; },
+                'Z');
+
+        spawningBuilder
+            .Go()
+            .AssistAndWaitForAll();
+
+        if (spawningBuilder.Failed() || runsSeenAfter != kChildCount)
+        {
+            return 1;
+        }
+    }
+
+#ifdef JOBSYSTEM_EXCEPTIONS_ENABLED
+
+    // A child's exception fails its parent, and reaches whoever waits on the parent.
+    {
+        jobsystem::JobStatePtr parent = jobManager.AddJob([&]()
+                                                          {
+                                                              jobManager.SpawnChild([]() {});
+                                                              jobManager.SpawnChild([]()
+                                                                                    { throw 7; }); });
+        parent->SetReady();
+
+        int caught = 0;
+        try
+        {
+            jobManager.AssistUntilJobDone(parent);
+        }
+        catch (int value)
+        {
+            caught = value;
+        }
+
+        if (caught != 7)
+        {
+            return 1;
+        }
+    }
+
+    // A throwing SpawnLoop() iteration ends the loop, and fails the job running it.
+    {
+        std::atomic<int> iterations(0);
+
+        jobsystem::JobStatePtr loop = jobManager.AddJob([&]()
+                                                        { jobManager.SpawnLoop([&]()
+                                                                               { return iterations < 100; },
+                                                                               [&]()
+                                                                               {
+                                                                                   if (++iterations == 3)
+                                                                                       throw 3;
+                                                                               }); });
+        loop->SetReady();
+
+        int caught = 0;
+        try
+        {
+            jobManager.AssistUntilJobDone(loop);
+        }
+        catch (int value)
+        {
+            caught = value;
+        }
+
+        if (caught != 3 || iterations != 3)
+        {
+            return 1;
+        }
+    }
+
+#endif // JOBSYSTEM_EXCEPTIONS_ENABLED
+
+#ifdef JOBSYSTEM_ENABLE_VALIDATION
+
+    // Stuck-job watchdog: a job that was never readied, and the job waiting on it, are each reported
+    // once.
+    {
+        jobsystem::JobManagerDescriptor watchdogDesc;
+        watchdogDesc.m_workers.emplace_back("Worker");
+
+        jobsystem::JobManager watchdogManager;
+        if (!watchdogManager.Create(watchdogDesc))
+        {
+            return 1;
+        }
+
+        jobsystem::JobStatePtr forgotten = watchdogManager.AddJob([]() {}, 'f');
+        jobsystem::JobStatePtr waiting = watchdogManager.AddJob([]() {}, 'w');
+        forgotten->AddDependant(waiting);
+        waiting->SetReady();
+
+        const size_t reported = watchdogManager.DumpStuckJobs(0);
+        const size_t reportedAgain = watchdogManager.DumpStuckJobs(0);
+
+        forgotten->SetReady();
+        watchdogManager.AssistUntilJobDone(waiting);
+
+        if (reported != 2 || reportedAgain != 0)
+        {
+            return 1;
+        }
+    }
+
+#endif // JOBSYSTEM_ENABLE_VALIDATION
+
+    const jobsystem::ESpawnPolicy policies[] = {jobsystem::eSpawnPolicy_HelpFirst, jobsystem::eSpawnPolicy_WorkFirst};
+
+    // ParallelFor() visits every index exactly once, whichever way it splits the range.
+    for (jobsystem::ESpawnPolicy policy : policies)
+    {
+        const size_t kIndexCount = 10000;
+        std::vector<std::atomic<int>> visits(kIndexCount);
+
+        jobManager.ParallelFor(0, kIndexCount, 7, [&](size_t begin, size_t end)
+                               {
+                                   for (size_t i = begin; i < end; ++i)
+                                       ++visits[i]; },
+                               policy);
+
+        for (const std::atomic<int> &visitCount : visits)
+        {
+            if (visitCount != 1)
+            {
+                return 1;
+            }
+        }
+    }
+
+#ifdef JOBSYSTEM_EXCEPTIONS_ENABLED
+
+    // ForkJoin() rethrows a half's exception only once the other half, which may reference the
+    // caller's stack, has finished. Either half may throw, and either may be the queued one.
+    for (jobsystem::ESpawnPolicy policy : policies)
+    {
+        for (int throwingHalf = 0; throwingHalf < 2; ++throwingHalf)
+        {
+            std::atomic<bool> otherHalfDone(false);
+
+            auto throwing = []()
+            {
+                throw 5;
+            };
+
+            auto slow = [&]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                otherHalfDone = true;
+            };
+
+            bool doneWhenCaught = false;
+            try
+            {
+                if (throwingHalf == 0)
+                {
+                    jobManager.ForkJoin(throwing, slow, policy);
+                }
+                else
+                {
+                    jobManager.ForkJoin(slow, throwing, policy);
+                }
+            }
+            catch (int)
+            {
+                doneWhenCaught = otherHalfDone;
+            }
+
+            if (!doneWhenCaught)
+            {
+                return 1;
+            }
+        }
+    }
+
+#endif // JOBSYSTEM_EXCEPTIONS_ENABLED
+
+    // Regression: a deterministic recording including a job run nested inside another job's wait
+    // must replay without diverging.
+    {
+        jobsystem::JobSchedule schedule;
+
+        for (int replay = 0; replay < 2; ++replay)
+        {
+            jobsystem::JobManagerDescriptor deterministicDesc;
+            deterministicDesc.m_workers.emplace_back("Worker");
+            deterministicDesc.m_workers.emplace_back("Worker");
+            deterministicDesc.m_deterministic = true;
+            deterministicDesc.m_replaySchedule = schedule;
+
+            jobsystem::JobManager deterministicManager;
+            if (!deterministicManager.Create(deterministicDesc))
+            {
+                return 1;
+            }
+
+            jobsystem::JobStatePtr outer = deterministicManager.AddJob([&]()
+                                                                       {
+                                                                           jobsystem::JobStatePtr inner = deterministicManager.AddJob([]() {}, 'b');
+                                                                           inner->SetReady();
+                                                                           deterministicManager.AssistUntilJobDone(inner); },
+                                                                       'a');
+            outer->SetReady();
+            deterministicManager.AssistUntilJobDone(outer);
+
+            const jobsystem::JobSchedule &recorded = deterministicManager.GetRecordedSchedule();
+            if (recorded.size() != 2 || recorded[0].debugChar != 'a' || recorded[1].debugChar != 'b')
+            {
+                return 1;
+            }
+
+            schedule = recorded;
+        }
+    }
+
     return builder.Failed() ? 1 : 0;
 }